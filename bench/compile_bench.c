@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+/*
+ * Compile throughput benchmark. Each shape of progen.h is compiled at -O0 at
+ * its size and at twice that, in a child process of its own so the peak RSS
+ * is the compilation's. The time ratio between the two sizes gives the
+ * scaling exponent, 1 for linear work, so a quadratic phase shows up even on
+ * a fast machine. Lines per second and memory are compared with a baseline
+ * written by an earlier run.
+ *
+ * Usage: compile_bench [-n iterations] [-scale factor] [-o results.json]
+ *                      [-baseline baseline.json] [-tolerance percent]
+ *                      [-print shape size]
+ */
+
+#define _DEFAULT_SOURCE // wait4
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../src/pl0c.h"
+#include "progen.h"
+
+#define SUPERLINEAR 1.5 // scaling exponents above this are reported
+
+/* Size of each shape at scale 1, for runs of a few tens of milliseconds */
+static const size_t base_sizes[SHAPE_COUNT] = {
+    [SHAPE_GLOBALS] = 20000,    [SHAPE_PROCEDURES] = 5000,
+    [SHAPE_BLOCK] = 50000,      [SHAPE_NESTING] = 2000,
+    [SHAPE_EXPRESSION] = 20000,
+};
+
+/* Phases of pl0c_stats_t, to find the one scaling worst */
+static const struct {
+    const char* name;
+    size_t offset;
+} phases[] = {
+    { "scan", offsetof(pl0c_stats_t, scan_seconds) },
+    { "parse", offsetof(pl0c_stats_t, parse_seconds) },
+    { "drop_uncalled", offsetof(pl0c_stats_t, prune_seconds) },
+    { "run_semantic_checks", offsetof(pl0c_stats_t, check_seconds) },
+    { "fold_constants", offsetof(pl0c_stats_t, fold_seconds) },
+    { "generate_code", offsetof(pl0c_stats_t, generate_seconds) },
+    { "verify", offsetof(pl0c_stats_t, verify_seconds) },
+};
+
+#define PHASE_COUNT (sizeof(phases) / sizeof(phases[0]))
+
+/* One compilation, measured in a child */
+typedef struct {
+    bool ok;
+    size_t lines;
+    double seconds; // best of the iterations
+    pl0c_stats_t stats;
+    double peak_rss_mb;
+} sample_t;
+
+static double phase_seconds(const pl0c_stats_t* stats, size_t phase)
+{
+    return *(const double*)((const char*)stats + phases[phase].offset);
+}
+
+/* Compile text iterations times on this process; the best run is the result */
+static sample_t compile_text(const char* text, size_t len, int iterations)
+{
+    sample_t sample = { 0 };
+    for (size_t i = 0; i < len; i++) {
+        sample.lines += text[i] == '\n';
+    }
+
+    pl0c_context_t* ctx = pl0c_create_context();
+    if (!ctx)
+        return sample;
+    pl0c_options_t options = { .stats = true };
+    pl0c_set_options(ctx, &options);
+
+    sample.ok = true;
+    sample.seconds = 1e30;
+    for (int i = 0; sample.ok && i < iterations; i++) {
+        LLVMModuleRef module = pl0c_compile_module(ctx, "bench.pl0", text, len);
+        sample.ok = module != NULL;
+        if (module)
+            LLVMDisposeModule(module);
+
+        const pl0c_stats_t* stats = pl0c_stats(ctx);
+        double seconds = 0;
+        for (size_t p = 0; p < PHASE_COUNT; p++) {
+            seconds += phase_seconds(stats, p);
+        }
+        if (seconds < sample.seconds) {
+            sample.seconds = seconds;
+            sample.stats = *stats;
+        }
+    }
+
+    for (size_t i = 0; !sample.ok && i < pl0c_error_count(ctx); i++) {
+        fprintf(stderr, "bench.pl0: %s\n", pl0c_error_message(ctx, i));
+    }
+    pl0c_destroy_context(ctx);
+    return sample;
+}
+
+/* Generate and compile shape at size in a child process */
+static sample_t measure(shape_t shape, size_t size, int iterations)
+{
+    sample_t sample = { 0 };
+    int fds[2];
+    if (pipe(fds) != 0)
+        return sample;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        size_t len;
+        char* text = generate_program(shape, size, &len);
+        sample_t result = { 0 };
+        if (text)
+            result = compile_text(text, len, iterations);
+        free(text);
+        bool written = write(fds[1], &result, sizeof(result)) == sizeof(result);
+        _exit(written ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        return sample;
+    }
+
+    /* a crash, such as running out of stack, leaves the pipe empty */
+    if (read(fds[0], &sample, sizeof(sample)) != sizeof(sample))
+        memset(&sample, 0, sizeof(sample));
+    close(fds[0]);
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) == pid)
+        sample.peak_rss_mb = usage.ru_maxrss / 1e3; // kilobytes on Linux
+    return sample;
+}
+
+/* Exponent of the growth from the time at size n to the time at 2n */
+static double scaling(double at_n, double at_2n)
+{
+    return at_n > 0 && at_2n > 0 ? log2(at_2n / at_n) : 0;
+}
+
+/* The number after "key": on the line of shape in a results file, or 0 */
+static double baseline_value(const char* baseline, shape_t shape, const char* key)
+{
+    char shape_key[64];
+    snprintf(shape_key, sizeof(shape_key), "\"shape\": \"%s\"", shape_name(shape));
+    const char* line = baseline ? strstr(baseline, shape_key) : NULL;
+    if (!line)
+        return 0;
+    const char* end = strchr(line, '\n');
+
+    char number_key[64];
+    snprintf(number_key, sizeof(number_key), "\"%s\": ", key);
+    const char* value = strstr(line, number_key);
+    if (!value || (end && value > end))
+        return 0;
+    return strtod(value + strlen(number_key), NULL);
+}
+
+static char* read_file(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    char* text = NULL;
+    size_t len = 0;
+    size_t capacity = 0;
+    for (;;) {
+        if (len + 1 >= capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            char* grown = realloc(text, capacity);
+            if (!grown)
+                break;
+            text = grown;
+        }
+        size_t n = fread(text + len, 1, capacity - len - 1, f);
+        if (n == 0)
+            break;
+        len += n;
+    }
+    fclose(f);
+    if (text)
+        text[len] = '\0';
+    return text;
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [-n iterations] [-scale factor] [-o results.json]\n"
+            "       [-baseline baseline.json] [-tolerance percent]\n"
+            "       [-print shape size]\n",
+            program);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = 5;
+    double scale = 1;
+    const char* results_path = NULL;
+    const char* baseline_path = NULL;
+    double tolerance = 20;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-scale") == 0 && i + 1 < argc) {
+            scale = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            results_path = argv[++i];
+        } else if (strcmp(argv[i], "-baseline") == 0 && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "-tolerance") == 0 && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-print") == 0 && i + 2 < argc) {
+            /* the generator alone, to look at a shape or feed it to pl0c */
+            shape_t shape = find_shape(argv[i + 1]);
+            if (shape == SHAPE_COUNT)
+                usage(argv[0]);
+            size_t len;
+            char* text = generate_program(shape, strtoul(argv[i + 2], NULL, 10),
+                                          &len);
+            bool ok = text && fwrite(text, 1, len, stdout) == len;
+            free(text);
+            return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (iterations < 1 || scale <= 0)
+        usage(argv[0]);
+
+    /* a missing baseline is not an error: the first run makes one */
+    char* baseline = baseline_path ? read_file(baseline_path) : NULL;
+    if (baseline_path && !baseline)
+        fprintf(stderr, "note: no baseline in %s yet\n", baseline_path);
+
+    FILE* results = NULL;
+    if (results_path && !(results = fopen(results_path, "w"))) {
+        fprintf(stderr, "error: cannot write %s\n", results_path);
+        return EXIT_FAILURE;
+    }
+    if (results)
+        fprintf(results, "{\"pl0c\": \"%s\", \"shapes\": [", PL0C_VERSION);
+
+    printf("%-11s %9s %11s %8s %8s  %-22s %s\n", "shape", "lines", "lines/s",
+           "peak MB", "scaling", "worst phase", "vs baseline");
+
+    bool failed = false;
+    size_t recorded = 0;
+    for (shape_t shape = 0; shape < SHAPE_COUNT; shape++) {
+        size_t size = (size_t)(base_sizes[shape] * scale);
+        sample_t small = measure(shape, size, iterations);
+        sample_t large = measure(shape, 2 * size, iterations);
+        if (!small.ok || !large.ok) {
+            printf("%-11s failed to compile at size %zu\n", shape_name(shape),
+                   small.ok ? 2 * size : size);
+            failed = true;
+            continue;
+        }
+
+        double exponent = scaling(small.seconds, large.seconds);
+        size_t worst = 0;
+        double worst_exponent = 0;
+        for (size_t p = 0; p < PHASE_COUNT; p++) {
+            /* phases under a millisecond are too noisy to judge */
+            if (phase_seconds(&large.stats, p) < 1e-3)
+                continue;
+            double e = scaling(phase_seconds(&small.stats, p),
+                               phase_seconds(&large.stats, p));
+            if (e > worst_exponent) {
+                worst = p;
+                worst_exponent = e;
+            }
+        }
+
+        double lines_per_second = large.lines / large.seconds;
+        char worst_phase[32];
+        snprintf(worst_phase, sizeof(worst_phase), "%s %.2f", phases[worst].name,
+                 worst_exponent);
+        printf("%-11s %9zu %11.0f %8.1f %8.2f  %-22s", shape_name(shape),
+               large.lines, lines_per_second, large.peak_rss_mb, exponent,
+               worst_phase);
+
+        double base_speed = baseline_value(baseline, shape, "lines_per_second");
+        double base_rss = baseline_value(baseline, shape, "peak_rss_mb");
+        if (base_speed > 0 && base_rss > 0) {
+            double speed = lines_per_second / base_speed;
+            double memory = large.peak_rss_mb / base_rss;
+            printf(" %.2fx speed, %.2fx memory", speed, memory);
+            if (speed < 1 - tolerance / 100 || memory > 1 + tolerance / 100) {
+                printf("  REGRESSION");
+                failed = true;
+            }
+        }
+        if (exponent > SUPERLINEAR) {
+            printf("  SUPERLINEAR");
+            failed = true;
+        }
+        printf("\n");
+
+        if (results) {
+            fprintf(results,
+                    "%s\n  {\"shape\": \"%s\", \"size\": %zu, \"lines\": %zu, "
+                    "\"seconds\": %.6f, \"lines_per_second\": %.0f, "
+                    "\"peak_rss_mb\": %.1f, \"scaling\": %.3f}",
+                    recorded++ ? "," : "", shape_name(shape), 2 * size, large.lines,
+                    large.seconds, lines_per_second, large.peak_rss_mb, exponent);
+        }
+    }
+
+    if (results) {
+        fprintf(results, "\n]}\n");
+        if (fclose(results) != 0) {
+            fprintf(stderr, "error: cannot write %s\n", results_path);
+            failed = true;
+        }
+    }
+    free(baseline);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
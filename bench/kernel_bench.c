@@ -0,0 +1,452 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+/*
+ * Execution benchmark. Every kernel.pl0 of a directory is built by pl0c at
+ * -O0 to -O3 and run both as a native executable and under --run, each run
+ * reading kernel.in and checked against kernel.out. The median wall time and
+ * the median count of user space instructions retired are reported. JIT
+ * runs include compiling, as a user of --run sees it.
+ *
+ * Usage: kernel_bench [-n runs] [-pl0c path] [-dir kernels]
+ *                     [-flags "pl0c flags"] [-o results.json]
+ */
+
+#define _DEFAULT_SOURCE // mkdtemp
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <linux/perf_event.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_ARGS 64
+
+typedef enum {
+    MODE_NATIVE, // executable linked by pl0c
+    MODE_JIT,    // pl0c --run
+    MODE_COUNT,
+} exec_mode_t;
+
+static const char* mode_names[] = { "native", "jit" };
+
+/* A command line, built up one argument at a time */
+typedef struct {
+    char* argv[MAX_ARGS + 1];
+    int argc;
+} command_t;
+
+static void add_arg(command_t* c, const char* arg)
+{
+    if (c->argc < MAX_ARGS)
+        c->argv[c->argc++] = (char*)arg;
+    c->argv[c->argc] = NULL;
+}
+
+/* Each word of flags, which is modified in place */
+static void add_flags(command_t* c, char* flags)
+{
+    for (char* word = strtok(flags, " "); word; word = strtok(NULL, " ")) {
+        add_arg(c, word);
+    }
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Counter of user space instructions retired by pid once it calls exec, or
+ * -1 if the kernel doesn't allow it
+ */
+static int count_instructions(pid_t pid)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+}
+
+/* Everything read from fd until the end, NUL terminated; NULL if out of memory */
+static char* read_all(int fd)
+{
+    char* text = NULL;
+    size_t len = 0;
+    FILE* capture = open_memstream(&text, &len);
+    if (!capture)
+        return NULL;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) != 0) {
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            break;
+        fwrite(buf, 1, n, capture);
+    }
+    fclose(capture);
+    return text;
+}
+
+/* One run of a command */
+typedef struct {
+    bool ok;             // exited with 0 and printed the expected output
+    double seconds;
+    int64_t instructions; // -1 if they couldn't be counted
+} run_t;
+
+/*
+ * Run command with stdin from input, or /dev/null if NULL, and compare what
+ * it prints with expected
+ */
+static run_t run_command(const command_t* command, const char* input,
+                         const char* expected)
+{
+    run_t run = { false, 0, -1 };
+    int go[2];
+    int output[2];
+    if (pipe(go) != 0)
+        return run;
+    if (pipe(output) != 0) {
+        close(go[0]);
+        close(go[1]);
+        return run;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        /* exec only once the parent has attached the counter */
+        char c;
+        close(go[1]);
+        close(output[0]);
+        if (read(go[0], &c, 1) != 1)
+            _exit(127);
+        int in = open(input ? input : "/dev/null", O_RDONLY);
+        if (in < 0 || dup2(in, STDIN_FILENO) < 0 ||
+            dup2(output[1], STDOUT_FILENO) < 0)
+            _exit(127);
+        execvp(command->argv[0], command->argv);
+        _exit(127);
+    }
+    close(go[0]);
+    close(output[1]);
+    if (pid < 0) {
+        close(go[1]);
+        close(output[0]);
+        return run;
+    }
+
+    int counter = count_instructions(pid);
+    double start = now();
+    bool started = write(go[1], "g", 1) == 1;
+    close(go[1]);
+
+    char* printed = read_all(output[0]);
+    close(output[0]);
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    run.seconds = now() - start;
+
+    uint64_t count;
+    if (counter >= 0 && read(counter, &count, sizeof(count)) == sizeof(count))
+        run.instructions = (int64_t)count;
+    if (counter >= 0)
+        close(counter);
+
+    run.ok = started && WIFEXITED(status) && WEXITSTATUS(status) == 0 && printed &&
+             strcmp(printed, expected) == 0;
+    free(printed);
+    return run;
+}
+
+/*
+ * Run command and wait for it. What it prints, such as pl0c's summary, is
+ * only passed on to stderr if it fails.
+ */
+static bool build(const command_t* command)
+{
+    int output[2];
+    if (pipe(output) != 0)
+        return false;
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(output[0]);
+        dup2(output[1], STDOUT_FILENO);
+        dup2(output[1], STDERR_FILENO);
+        execvp(command->argv[0], command->argv);
+        _exit(127);
+    }
+    close(output[1]);
+
+    char* printed = read_all(output[0]);
+    close(output[0]);
+
+    int status;
+    bool ok = pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+              WEXITSTATUS(status) == 0;
+    if (!ok && printed)
+        fputs(printed, stderr);
+    free(printed);
+    return ok;
+}
+
+static int by_seconds(const void* lhs, const void* rhs)
+{
+    double a = ((const run_t*)lhs)->seconds;
+    double b = ((const run_t*)rhs)->seconds;
+    return (a > b) - (a < b);
+}
+
+static int by_instructions(const void* lhs, const void* rhs)
+{
+    int64_t a = ((const run_t*)lhs)->instructions;
+    int64_t b = ((const run_t*)rhs)->instructions;
+    return (a > b) - (a < b);
+}
+
+static int by_name(const void* lhs, const void* rhs)
+{
+    return strcmp(*(char* const*)lhs, *(char* const*)rhs);
+}
+
+/* Names of the kernels in dir, without .pl0, sorted */
+static char** find_kernels(const char* dir, size_t* count)
+{
+    DIR* d = opendir(dir);
+    if (!d)
+        return NULL;
+    char** names = NULL;
+    size_t capacity = 0;
+    *count = 0;
+    struct dirent* e;
+    while ((e = readdir(d))) {
+        size_t len = strlen(e->d_name);
+        if (len <= 4 || strcmp(e->d_name + len - 4, ".pl0") != 0)
+            continue;
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            char** grown = realloc(names, capacity * sizeof(char*));
+            if (!grown)
+                break;
+            names = grown;
+        }
+        names[*count] = strndup(e->d_name, len - 4);
+        if (names[*count])
+            (*count)++;
+    }
+    closedir(d);
+    qsort(names, *count, sizeof(char*), by_name);
+    return names;
+}
+
+static char* read_file(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    char* text = NULL;
+    size_t len = 0;
+    FILE* out = open_memstream(&text, &len);
+    char buf[4096];
+    size_t n;
+    while (out && (n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        fwrite(buf, 1, n, out);
+    }
+    fclose(f);
+    if (out)
+        fclose(out);
+    return text;
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [-n runs] [-pl0c path] [-dir kernels]\n"
+            "       [-flags \"pl0c flags\"] [-o results.json]\n",
+            program);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+    int runs = 5;
+    const char* pl0c = "./pl0c";
+    const char* dir = "bench/kernels";
+    const char* flags = "";
+    const char* results_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            runs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-pl0c") == 0 && i + 1 < argc)
+            pl0c = argv[++i];
+        else if (strcmp(argv[i], "-dir") == 0 && i + 1 < argc)
+            dir = argv[++i];
+        else if (strcmp(argv[i], "-flags") == 0 && i + 1 < argc)
+            flags = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            results_path = argv[++i];
+        else
+            usage(argv[0]);
+    }
+    if (runs < 1)
+        usage(argv[0]);
+
+    size_t kernel_count = 0;
+    char** kernels = find_kernels(dir, &kernel_count);
+    if (!kernel_count) {
+        fprintf(stderr, "error: no kernels in %s\n", dir);
+        return EXIT_FAILURE;
+    }
+
+    const char* tmp = getenv("TMPDIR");
+    char build_dir[4096];
+    snprintf(build_dir, sizeof(build_dir), "%s/pl0c-bench-XXXXXX",
+             tmp && *tmp ? tmp : "/tmp");
+    if (!mkdtemp(build_dir)) {
+        fprintf(stderr, "error: cannot create a directory in %s\n",
+                tmp && *tmp ? tmp : "/tmp");
+        return EXIT_FAILURE;
+    }
+
+    FILE* results = NULL;
+    if (results_path && !(results = fopen(results_path, "w"))) {
+        fprintf(stderr, "error: cannot write %s\n", results_path);
+        return EXIT_FAILURE;
+    }
+    if (results)
+        fprintf(results, "{\"flags\": \"%s\", \"runs\": [", flags);
+
+    printf("%-10s %-5s %-7s %12s %16s  %s\n", "kernel", "level", "mode",
+           "median ms", "instructions", "output");
+
+    run_t* samples = calloc(runs, sizeof(run_t));
+    bool failed = !samples;
+    size_t recorded = 0;
+    for (size_t k = 0; samples && k < kernel_count; k++) {
+        char source[4096], input[4096], expected_path[4096], executable[4096];
+        snprintf(source, sizeof(source), "%s/%s.pl0", dir, kernels[k]);
+        snprintf(input, sizeof(input), "%s/%s.in", dir, kernels[k]);
+        snprintf(expected_path, sizeof(expected_path), "%s/%s.out", dir,
+                 kernels[k]);
+        char* expected = read_file(expected_path);
+        if (!expected) {
+            fprintf(stderr, "error: %s not found\n", expected_path);
+            failed = true;
+            continue;
+        }
+        bool has_input = access(input, R_OK) == 0;
+
+        for (int level = 0; level <= 3; level++) {
+            char opt[8];
+            snprintf(opt, sizeof(opt), "-O%d", level);
+            if (snprintf(executable, sizeof(executable), "%s/%s%s", build_dir,
+                         kernels[k], opt) >= (int)sizeof(executable)) {
+                fprintf(stderr, "error: path of %s too long\n", kernels[k]);
+                failed = true;
+                break;
+            }
+
+            for (exec_mode_t mode = 0; mode < MODE_COUNT; mode++) {
+                /* the commands point into words until the runs are done */
+                char* words = strdup(flags);
+                command_t command = { { NULL }, 0 };
+                bool built = words != NULL;
+                if (built && mode == MODE_NATIVE) {
+                    command_t compile = { { NULL }, 0 };
+                    add_arg(&compile, pl0c);
+                    add_arg(&compile, opt);
+                    add_flags(&compile, words);
+                    add_arg(&compile, "-o");
+                    add_arg(&compile, executable);
+                    add_arg(&compile, source);
+                    built = build(&compile);
+                    add_arg(&command, executable);
+                } else if (built) {
+                    add_arg(&command, pl0c);
+                    add_arg(&command, "--run");
+                    add_arg(&command, opt);
+                    add_flags(&command, words);
+                    add_arg(&command, source);
+                }
+
+                bool ok = built;
+                for (int r = 0; ok && r < runs; r++) {
+                    samples[r] =
+                        run_command(&command, has_input ? input : NULL, expected);
+                    ok = samples[r].ok;
+                }
+                free(words);
+                if (!ok) {
+                    printf("%-10s %-5s %-7s %12s %16s  %s\n", kernels[k], opt,
+                           mode_names[mode], "-", "-",
+                           built ? "WRONG" : "BUILD FAILED");
+                    failed = true;
+                    continue;
+                }
+
+                qsort(samples, runs, sizeof(run_t), by_seconds);
+                double median = samples[runs / 2].seconds;
+                qsort(samples, runs, sizeof(run_t), by_instructions);
+                int64_t instructions = samples[runs / 2].instructions;
+
+                char counted[32] = "-";
+                if (instructions >= 0)
+                    snprintf(counted, sizeof(counted), "%" PRId64, instructions);
+                printf("%-10s %-5s %-7s %12.2f %16s  ok\n", kernels[k], opt,
+                       mode_names[mode], median * 1e3, counted);
+                fflush(stdout);
+
+                if (results) {
+                    fprintf(results,
+                            "%s\n  {\"kernel\": \"%s\", \"opt_level\": %d, "
+                            "\"mode\": \"%s\", \"median_seconds\": %.6f, "
+                            "\"instructions\": %" PRId64 "}",
+                            recorded++ ? "," : "", kernels[k], level,
+                            mode_names[mode], median, instructions);
+                }
+            }
+            unlink(executable);
+        }
+        free(expected);
+    }
+    rmdir(build_dir);
+
+    if (results) {
+        fprintf(results, "\n]}\n");
+        if (fclose(results) != 0) {
+            fprintf(stderr, "error: cannot write %s\n", results_path);
+            failed = true;
+        }
+    }
+    for (size_t k = 0; k < kernel_count; k++) {
+        free(kernels[k]);
+    }
+    free(kernels);
+    free(samples);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
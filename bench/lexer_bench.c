@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+/*
+ * Lexer microbenchmark. Runs scan_buffer over a PL/0 file, or over a
+ * generated corpus when no file is given, and reports bytes per second.
+ * -idents switches the generated corpus to one made almost entirely of
+ * identifiers, mostly non-keywords, to stress keyword recognition.
+ *
+ * Usage: lexer_bench [-n iterations] [-idents] [file.pl0]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/lexer.h"
+#include "../src/source.h"
+
+#define CORPUS_SIZE (32u << 20)
+
+static const char* corpus_lines[] = {
+    "# generated corpus for the lexer benchmark\n",
+    "var counter_value, running_total, index_i, tmp;\n",
+    "const LIMIT = 1000000, STEP = 17;\n",
+    "procedure accumulate_values:\n",
+    "begin\n",
+    "    running_total = running_total + counter_value * STEP - (index_i / 3);\n",
+    "    while index_i <= LIMIT:\n",
+    "        index_i = index_i + 1;\n",
+    "    if odd running_total: print running_total;\n",
+    "    else: print 0;\n",
+    "    call accumulate_values;\n",
+    "end\n",
+    "\n",
+};
+
+static const char* ident_lines[] = {
+    "var alpha, beta, gamma, delta, epsilon, zeta, eta, theta, iota, kappa;\n",
+    "alpha = beta + gamma * delta - epsilon / zeta + eta - theta * iota;\n",
+    "call update_state; call Vars; call odd_count; call printer; call x1;\n",
+    "CounterA = CounterB + idx_i + idx_j + sum_total + END_MARK + Begin2;\n",
+    "if x == y: while tmp_value < limit_value: scan input_value;\n",
+    "print result_value; print else_branch; print whilex; print procedures;\n",
+};
+
+static char* generate_corpus(const char** lines, size_t line_count, size_t* len)
+{
+    char* buf = malloc(CORPUS_SIZE);
+    size_t n = 0;
+    size_t line = 0;
+
+    for (;;) {
+        const char* s = lines[line++ % line_count];
+        size_t s_len = strlen(s);
+        if (n + s_len > CORPUS_SIZE)
+            break;
+        memcpy(buf + n, s, s_len);
+        n += s_len;
+    }
+    *len = n;
+    return buf;
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = 10;
+    const char* file_name = NULL;
+    bool idents = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-idents") == 0)
+            idents = true;
+        else
+            file_name = argv[i];
+    }
+
+    source_t src = { 0 };
+    const char* text;
+    size_t len;
+    char* corpus = NULL;
+
+    if (file_name) {
+        if (!load_source(file_name, &src)) {
+            fprintf(stderr, "error: %s not found\n", file_name);
+            return EXIT_FAILURE;
+        }
+        text = src.text;
+        len = src.len;
+    } else if (idents) {
+        size_t line_count = sizeof(ident_lines) / sizeof(ident_lines[0]);
+        corpus = generate_corpus(ident_lines, line_count, &len);
+        text = corpus;
+    } else {
+        size_t line_count = sizeof(corpus_lines) / sizeof(corpus_lines[0]);
+        corpus = generate_corpus(corpus_lines, line_count, &len);
+        text = corpus;
+    }
+
+    double best = 1e30;
+    for (int i = 0; i < iterations; i++) {
+        token_stream_t tokens;
+        intern_table_t names;
+        init_intern_table(&names);
+        double start = now();
+        scan_buffer(text, len, &tokens, &names);
+        double elapsed = now() - start;
+        free_token_stream(&tokens);
+        free_interned(&names);
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    printf("%zu bytes, best of %d: %.3f ms, %.1f MB/s\n", len, iterations,
+           best * 1e3, len / best / 1e6);
+
+    if (file_name)
+        release_source(&src);
+    free(corpus);
+    return 0;
+}
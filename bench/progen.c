@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "progen.h"
+
+#define NAMES_PER_LINE 8
+#define TERMS_PER_LINE 8
+
+static const char* shape_names[] = {
+    [SHAPE_GLOBALS] = "globals",
+    [SHAPE_PROCEDURES] = "procedures",
+    [SHAPE_BLOCK] = "block",
+    [SHAPE_NESTING] = "nesting",
+    [SHAPE_EXPRESSION] = "expression",
+};
+
+const char* shape_name(shape_t shape)
+{
+    return shape < SHAPE_COUNT ? shape_names[shape] : "";
+}
+
+shape_t find_shape(const char* name)
+{
+    shape_t shape = 0;
+    while (shape < SHAPE_COUNT && strcmp(shape_names[shape], name) != 0) {
+        shape++;
+    }
+    return shape;
+}
+
+static void globals(FILE* f, size_t size)
+{
+    size_t consts = size / 2;
+    size_t vars = size - consts;
+
+    fprintf(f, "const");
+    for (size_t i = 0; i < consts; i++) {
+        fprintf(f, "%s c%zu = %zu", i % NAMES_PER_LINE ? "," : i ? ",\n   " : "",
+                i, i);
+    }
+    fprintf(f, "%s;\n", consts ? "" : " zero = 0");
+
+    fprintf(f, "var");
+    for (size_t i = 0; i < vars; i++) {
+        fprintf(f, "%s g%zu", i % NAMES_PER_LINE ? "," : i ? ",\n   " : "", i);
+    }
+    fprintf(f, "%s;\n\nbegin\n", vars ? "" : " unused");
+
+    for (size_t i = 0; i < vars; i++) {
+        if (i < consts)
+            fprintf(f, "    g%zu = c%zu;\n", i, i);
+        else
+            fprintf(f, "    g%zu = %zu;\n", i, i);
+    }
+    fprintf(f, "end\n");
+}
+
+static void procedures(FILE* f, size_t size)
+{
+    fprintf(f, "var total;\n\n");
+    for (size_t i = 0; i < size; i++) {
+        fprintf(f, "procedure p%zu:\n", i);
+        fprintf(f, "const step = %zu;\n", i % 7 + 1);
+        fprintf(f, "var a, b;\n");
+        fprintf(f, "begin\n");
+        fprintf(f, "    a = total + step;\n");
+        fprintf(f, "    b = a * 2;\n");
+        fprintf(f, "    total = b - a;\n");
+        if (i)
+            fprintf(f, "    call p%zu;\n", i - 1);
+        fprintf(f, "end\n\n");
+    }
+    fprintf(f, "begin\n");
+    if (size)
+        fprintf(f, "    call p%zu;\n", size - 1);
+    fprintf(f, "    print total;\nend\n");
+}
+
+static void block(FILE* f, size_t size)
+{
+    fprintf(f, "var x, y, i;\n\n");
+    fprintf(f, "procedure nothing:\nbegin\nend\n\nbegin\n");
+    for (size_t i = 0; i < size; i++) {
+        switch (i % 4) {
+        case 0:
+            fprintf(f, "    x = x + %zu;\n", i);
+            break;
+        case 1:
+            fprintf(f, "    y = x * 3 - y;\n");
+            break;
+        case 2:
+            fprintf(f, "    if x > y: i = i + 1;\n");
+            break;
+        default:
+            fprintf(f, "    call nothing;\n");
+        }
+    }
+    fprintf(f, "    print i;\nend\n");
+}
+
+static void nesting(FILE* f, size_t size)
+{
+    fprintf(f, "var x, i;\n\nbegin\n");
+    for (size_t d = 0; d < size; d++) {
+        if (d % 2)
+            fprintf(f, "while i < %zu:\nbegin\n    i = i + 1;\n", d);
+        else
+            fprintf(f, "if odd x + %zu:\nbegin\n    x = x + 1;\n", d);
+    }
+    for (size_t d = size; d-- > 0;) {
+        if (d % 2)
+            fprintf(f, "end\n");
+        else
+            fprintf(f, "end\nelse: x = x - 1;\n");
+    }
+    fprintf(f, "    print x;\nend\n");
+}
+
+static void expression(FILE* f, size_t size)
+{
+    static const char* terms[] = { "x", "y * 3", "(x - y) / 2", "17" };
+
+    fprintf(f, "var x, y, z;\n\nbegin\n    x = 5;\n    y = 7;\n    z = x");
+    for (size_t i = 1; i < size; i++) {
+        fprintf(f, "%s%s %s", i % TERMS_PER_LINE ? " " : "\n       ",
+                i % 2 ? "+" : "-", terms[i % 4]);
+    }
+    fprintf(f, ";\n    print z;\nend\n");
+}
+
+char* generate_program(shape_t shape, size_t size, size_t* len)
+{
+    char* text = NULL;
+    FILE* f = open_memstream(&text, len);
+    if (!f)
+        return NULL;
+
+    fprintf(f, "# %s, size %zu, generated by progen\n\n", shape_name(shape), size);
+    switch (shape) {
+    case SHAPE_GLOBALS:
+        globals(f, size);
+        break;
+    case SHAPE_PROCEDURES:
+        procedures(f, size);
+        break;
+    case SHAPE_BLOCK:
+        block(f, size);
+        break;
+    case SHAPE_NESTING:
+        nesting(f, size);
+        break;
+    case SHAPE_EXPRESSION:
+        expression(f, size);
+        break;
+    default:
+        break;
+    }
+
+    if (fclose(f) != 0) {
+        free(text);
+        return NULL;
+    }
+    return text;
+}
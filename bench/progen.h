@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef PROGEN_H
+#define PROGEN_H
+
+#include <stddef.h>
+
+/*
+ * Synthetic PL/0 programs, each stretching one dimension of the front end.
+ * Every program is valid and every procedure is called, so nothing is
+ * dropped before the semantic checks.
+ */
+typedef enum {
+    SHAPE_GLOBALS,     // size CONSTs and VARs, each used once by main
+    SHAPE_PROCEDURES,  // size procedures with locals, each calling the last
+    SHAPE_BLOCK,       // one BEGIN block of size statements
+    SHAPE_NESTING,     // IF and WHILE nested size deep
+    SHAPE_EXPRESSION,  // one expression of size terms
+    SHAPE_COUNT,
+} shape_t;
+
+const char* shape_name(shape_t shape);
+
+/* The shape called name, or SHAPE_COUNT if there is none */
+shape_t find_shape(const char* name);
+
+/*
+ * A program of shape grown to size, NUL terminated, with its length in *len.
+ * NULL if out of memory. The caller frees it.
+ */
+char* generate_program(shape_t shape, size_t size, size_t* len);
+
+#endif
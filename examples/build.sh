@@ -17,23 +17,10 @@ then
 	exit 1
 fi
 
-LL_EXT=".ll"
-OBJ_EXT=".o"
+# pl0c emits the object in-process and links it with the runtime library
+.././pl0c $PL0_SOURCE || exit 1
 
-NAME_LEN=${#PL0_SOURCE}
-NAME_WO_EXT=${PL0_SOURCE:0:$(($NAME_LEN-4))}
-
-LL_SOURCE="$NAME_WO_EXT$LL_EXT"
-OBJ="$NAME_WO_EXT$OBJ_EXT"
-
-.././pl0c $PL0_SOURCE
-llc -filetype=obj $LL_SOURCE
-clang -c io.c
-clang $OBJ io.o -o $NAME_WO_EXT
-
-if [ $SHOW_IR == 0 ]
+if [ $SHOW_IR == 1 ]
 then
-	rm -f $LL_SOURCE
+	.././pl0c -emit-llvm $PL0_SOURCE
 fi
-rm -f $OBJ
-rm -f io.o
\ No newline at end of file
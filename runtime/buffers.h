@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef BUFFERS_H
+#define BUFFERS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define PL0RT_BUFFER_SIZE (1 << 16)
+#define PL0RT_MAX_LINE 21 // sign, 19 digits and newline
+
+/*
+ * State of the runtime. print64 and scan64 (io.c) only work on the buffers
+ * and call out for everything else, so they are small enough to inline when
+ * pl0c links their bitcode into a program. The state and the slow paths
+ * (pl0rt.c) are only ever in libpl0rt, shared by all copies.
+ */
+typedef struct {
+    char output[PL0RT_BUFFER_SIZE];
+    size_t output_len;
+    bool output_started;
+    bool output_is_terminal; // flush every line, like a line buffered stdout
+
+    char input[PL0RT_BUFFER_SIZE];
+    size_t input_pos;
+    size_t input_len;
+    bool input_ended; // sticky, like the EOF flag of stdin
+} pl0rt_buffers_t;
+
+extern pl0rt_buffers_t pl0rt_buffers;
+
+/* Called before the first print */
+void pl0rt_start_output(void);
+
+/* Read more input into the empty input buffer; false at the end of input */
+bool pl0rt_refill(void);
+
+#endif
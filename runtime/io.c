@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+/*
+ * print64 and scan64 without stdio: numbers are converted by hand into a
+ * large output buffer, and input is read in large blocks and parsed in
+ * place, so a program printing or scanning millions of numbers does one
+ * system call per 64 KiB instead of formatting and locking per number.
+ *
+ * This file is also compiled to the bitcode that pl0c links into optimized
+ * programs, so it must only refer to the runtime through buffers.h.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "buffers.h"
+#include "pl0rt.h"
+
+/* Digit pairs "00" to "99", so numbers are converted two digits per division */
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324"
+    "25262728293031323334353637383940414243444546474849"
+    "50515253545556575859606162636465666768697071727374"
+    "75767778798081828384858687888990919293949596979899";
+
+void print64(int64_t num)
+{
+    pl0rt_buffers_t* b = &pl0rt_buffers;
+    if (!b->output_started)
+        pl0rt_start_output();
+    if (PL0RT_BUFFER_SIZE - b->output_len < PL0RT_MAX_LINE)
+        pl0rt_flush();
+
+    /* digits are produced from the right */
+    char digits[20];
+    char* end = digits + sizeof(digits);
+    char* p = end;
+    uint64_t magnitude = num < 0 ? 0 - (uint64_t)num : (uint64_t)num;
+    while (magnitude >= 100) {
+        const char* pair = &digit_pairs[magnitude % 100 * 2];
+        magnitude /= 100;
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+    if (magnitude >= 10) {
+        *--p = digit_pairs[magnitude * 2 + 1];
+        *--p = digit_pairs[magnitude * 2];
+    } else {
+        *--p = '0' + magnitude;
+    }
+
+    if (num < 0)
+        b->output[b->output_len++] = '-';
+    memcpy(&b->output[b->output_len], p, end - p);
+    b->output_len += end - p;
+    b->output[b->output_len++] = '\n';
+
+    if (b->output_is_terminal)
+        pl0rt_flush();
+}
+
+/* Next input byte without consuming it, or -1 at the end of input */
+static inline int peek(pl0rt_buffers_t* b)
+{
+    if (b->input_pos == b->input_len && !pl0rt_refill())
+        return -1;
+    return (unsigned char)b->input[b->input_pos];
+}
+
+int64_t scan64(void)
+{
+    pl0rt_buffers_t* b = &pl0rt_buffers;
+    int c;
+    while ((c = peek(b)) == ' ' || (c >= '\t' && c <= '\r')) {
+        b->input_pos++;
+    }
+
+    bool negative = c == '-';
+    if (c == '-' || c == '+') {
+        b->input_pos++;
+        c = peek(b);
+    }
+    if (c < '0' || c > '9')
+        return 0;
+
+    /* saturate like strtol, as scanf does */
+    uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : INT64_MAX;
+    uint64_t value = 0;
+    do {
+        unsigned digit = c - '0';
+        value = value > (limit - digit) / 10 ? limit : value * 10 + digit;
+        b->input_pos++;
+    } while ((c = peek(b)) >= '0' && c <= '9');
+
+    return negative ? (int64_t)(0 - value) : (int64_t)value;
+}
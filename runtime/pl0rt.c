@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+/* State and system calls of the runtime, behind the buffers of io.c */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "buffers.h"
+#include "pl0rt.h"
+
+pl0rt_buffers_t pl0rt_buffers;
+
+static void write_all(int fd, const char* buf, size_t len)
+{
+    while (len) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return; // nowhere to report it, as with a failed printf
+        buf += n;
+        len -= n;
+    }
+}
+
+void pl0rt_flush(void)
+{
+    write_all(STDOUT_FILENO, pl0rt_buffers.output, pl0rt_buffers.output_len);
+    pl0rt_buffers.output_len = 0;
+}
+
+void pl0rt_start_output(void)
+{
+    pl0rt_buffers.output_started = true;
+    pl0rt_buffers.output_is_terminal = isatty(STDOUT_FILENO);
+    atexit(pl0rt_flush);
+}
+
+bool pl0rt_refill(void)
+{
+    pl0rt_buffers_t* b = &pl0rt_buffers;
+    if (b->input_ended)
+        return false;
+
+    /* output asked for before this input must be seen first */
+    pl0rt_flush();
+
+    ssize_t n;
+    do {
+        n = read(STDIN_FILENO, b->input, sizeof(b->input));
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        b->input_ended = true;
+        return false;
+    }
+    b->input_pos = 0;
+    b->input_len = n;
+    return true;
+}
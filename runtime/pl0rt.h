@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef PL0RT_H
+#define PL0RT_H
+
+#include <stdint.h>
+
+/*
+ * Runtime of PL/0 programs, libpl0rt. Output is buffered until the buffer
+ * fills, the program waits for input or exits; on a terminal every line is
+ * written at once, as with stdio. Not thread safe: PL/0 programs have one
+ * thread.
+ */
+
+/* print: the number in decimal followed by a newline */
+void print64(int64_t num);
+
+/*
+ * scan: the next decimal number after any whitespace. Out of range numbers
+ * saturate; 0 if there is no number, as when scanf fails to match.
+ */
+int64_t scan64(void);
+
+/*
+ * Write out buffered output. Runs at exit; a host running programs in-process
+ * calls it once a program is done.
+ */
+void pl0rt_flush(void);
+
+#endif
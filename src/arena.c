@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/* Enough for pointers and int64_t, which is all the compiler stores here */
+#define ARENA_ALIGN 8
+#define ALIGN_UP(n, a) (((n) + (a)-1) & ~((a)-1))
+
+void arena_init(arena_t* arena, size_t block_size)
+{
+    arena->head = NULL;
+    arena->block_size = block_size;
+}
+
+void* arena_alloc(arena_t* arena, size_t size)
+{
+    size = ALIGN_UP(size, ARENA_ALIGN);
+    arena_block_t* block = arena->head;
+
+    if (!block || block->size - block->used < size) {
+        /* oversized requests get a block of their own */
+        size_t block_size = size > arena->block_size ? size : arena->block_size;
+        block = malloc(sizeof(arena_block_t) + block_size);
+        if (!block) {
+            return NULL;
+        }
+        block->prev = arena->head;
+        block->used = 0;
+        block->size = block_size;
+        arena->head = block;
+    }
+
+    void* ptr = (char*)block->data + block->used;
+    block->used += size;
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+arena_mark_t arena_mark(arena_t* arena)
+{
+    arena_mark_t mark = { arena->head, arena->head ? arena->head->used : 0 };
+    return mark;
+}
+
+void arena_rewind(arena_t* arena, arena_mark_t mark)
+{
+    while (arena->head != mark.block) {
+        arena_block_t* prev = arena->head->prev;
+        free(arena->head);
+        arena->head = prev;
+    }
+    if (arena->head) {
+        arena->head->used = mark.used;
+    }
+}
+
+void arena_release(arena_t* arena)
+{
+    arena_block_t* block = arena->head;
+    while (block) {
+        arena_block_t* prev = block->prev;
+        free(block);
+        block = prev;
+    }
+    arena->head = NULL;
+}
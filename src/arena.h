@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Bump pointer allocator. Objects are carved out of large blocks and can't be
+ * freed individually; arena_release() frees every block at once.
+ */
+typedef struct arena_block {
+    struct arena_block* prev;
+    size_t used;
+    size_t size;
+    max_align_t data[];
+} arena_block_t;
+
+typedef struct {
+    arena_block_t* head;
+    size_t block_size;
+} arena_t;
+
+/* A point in an arena's allocation history, see arena_rewind() */
+typedef struct {
+    arena_block_t* block;
+    size_t used;
+} arena_mark_t;
+
+void arena_init(arena_t* arena, size_t block_size);
+
+/* Returns zeroed, 8-byte aligned memory, or NULL if out of memory */
+void* arena_alloc(arena_t* arena, size_t size);
+
+arena_mark_t arena_mark(arena_t* arena);
+
+/* Free everything allocated since mark was taken */
+void arena_rewind(arena_t* arena, arena_mark_t mark);
+
+void arena_release(arena_t* arena);
+
+#endif
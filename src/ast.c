@@ -7,12 +7,9 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 
 #include "ast.h"
 
-static size_t global_node_count = 0;
-
 // Ignore clang warnings in get_label
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wswitch"
@@ -156,31 +153,43 @@ static void print_ast_label(ast_label_t label)
     }
 }
 
-ast_node_t* new_ast_node(token_t token)
+void init_ast_arena(ast_arena_t* ast_arena)
 {
-    ast_node_t* new_node = calloc(1, sizeof(ast_node_t));
+    arena_init(&ast_arena->arena, 64 * 1024);
+    ast_arena->node_count = 0;
+}
+
+ast_node_t* new_ast_node(ast_arena_t* ast_arena, token_t token)
+{
+    ast_node_t* new_node = arena_alloc(&ast_arena->arena, sizeof(ast_node_t));
+    if (!new_node) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
     new_node->label = get_label(token);
     new_node->first_child = NULL;
+    new_node->last_child = NULL;
     new_node->next_sibling = NULL;
-    strcpy(new_node->ident_name, token.value);
+    new_node->ident = token.ident;
     new_node->num_value = token.num_value;
-    global_node_count++;
+    ast_arena->node_count++;
     return new_node;
 }
 
 void append_child(ast_node_t* parent, ast_node_t* new_child)
 {
+    /* a missing statement, or a node lost to a syntax error, is not a child */
+    if (!new_child)
+        return;
+
     if (!parent->first_child) {
         parent->first_child = new_child;
     }
 
     else {
-        ast_node_t* current_child = parent->first_child;
-        while (current_child->next_sibling) {
-            current_child = current_child->next_sibling;
-        }
-        current_child->next_sibling = new_child;
+        parent->last_child->next_sibling = new_child;
     }
+    parent->last_child = new_child;
 }
 
 static size_t child_count(ast_node_t* node)
@@ -220,19 +229,77 @@ void print_ast(ast_node_t* root)
     }
 }
 
-size_t ast_node_count()
+size_t ast_node_count(const ast_arena_t* ast_arena)
 {
-    return global_node_count;
+    return ast_arena->node_count;
 }
 
-// Delete nodes recursively
-void cleanup_ast(ast_node_t** root_ref)
+// Release every node of the arena at once
+void release_ast(ast_arena_t* ast_arena, ast_node_t** root_ref)
 {
-    if (!(*root_ref))
-        return;
-    cleanup_ast(&((*root_ref)->first_child));
-    cleanup_ast(&((*root_ref)->next_sibling));
-    free(*root_ref);
+    arena_release(&ast_arena->arena);
+    ast_arena->node_count = 0;
     *root_ref = NULL;
-    global_node_count--;
-}
\ No newline at end of file
+}
+
+/*
+ * Append the subtree rooted at node to flat in preorder and return the index
+ * it was placed at. Sizes are filled in once the children are done.
+ */
+static size_t flatten_node(ast_node_t* node, flat_ast_t* flat)
+{
+    size_t index = flat->count++;
+    flat_node_t* out = &flat->nodes[index];
+    out->label = node->label;
+    out->payload = node->ident;
+
+    if (node->label == AST_NUM) {
+        out->payload = flat->num_count;
+        flat->nums[flat->num_count++] = node->num_value;
+    }
+
+    for (ast_node_t* child = node->first_child; child; child = child->next_sibling) {
+        flatten_node(child, flat);
+    }
+
+    flat->nodes[index].size = flat->count - index;
+    return index;
+}
+
+/*
+ * node_count is an upper bound on the size of the tree, such as the node count
+ * of the arena it was built in.
+ */
+bool flatten_ast(ast_node_t* root, size_t node_count, flat_ast_t* flat)
+{
+    flat->nodes = malloc(node_count * sizeof(flat_node_t));
+    flat->nums = malloc(node_count * sizeof(int64_t));
+    flat->count = 0;
+    flat->num_count = 0;
+
+    if (!flat->nodes || !flat->nums) {
+        free_flat_ast(flat);
+        return false;
+    }
+
+    flatten_node(root, flat);
+
+    /* give back what the upper bound overestimated */
+    flat_node_t* nodes = realloc(flat->nodes, flat->count * sizeof(flat_node_t));
+    flat->nodes = nodes ? nodes : flat->nodes;
+    if (flat->num_count) {
+        int64_t* nums = realloc(flat->nums, flat->num_count * sizeof(int64_t));
+        flat->nums = nums ? nums : flat->nums;
+    }
+    return true;
+}
+
+void free_flat_ast(flat_ast_t* flat)
+{
+    free(flat->nodes);
+    free(flat->nums);
+    flat->nodes = NULL;
+    flat->nums = NULL;
+    flat->count = 0;
+    flat->num_count = 0;
+}
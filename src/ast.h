@@ -7,9 +7,12 @@
 #ifndef AST_H
 #define AST_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "arena.h"
+#include "intern.h"
 #include "token.h"
 
 typedef enum {
@@ -47,20 +50,89 @@ typedef enum {
 
 typedef struct ast_node {
     ast_label_t label;
-    char ident_name[32];
+    uint32_t ident; // interned name, NO_IDENT for nodes without one
     int64_t num_value;
     struct ast_node* first_child;
+    struct ast_node* last_child; // for constant time append_child
     struct ast_node* next_sibling;
 } ast_node_t;
 
-ast_node_t* new_ast_node(token_t token);
+/* All nodes of one parse come out of a single arena and are released together */
+typedef struct {
+    arena_t arena;
+    size_t node_count;
+} ast_arena_t;
+
+void init_ast_arena(ast_arena_t* ast_arena);
+
+ast_node_t* new_ast_node(ast_arena_t* ast_arena, token_t token);
 
 void append_child(ast_node_t* parent, ast_node_t* new_child);
 
 void print_ast(ast_node_t* root);
 
-size_t ast_node_count();
+size_t ast_node_count(const ast_arena_t* ast_arena);
+
+void release_ast(ast_arena_t* ast_arena, ast_node_t** root_ref);
 
-void cleanup_ast(ast_node_t** root_ref);
+/*
+ * Flattened AST: every node of the tree in one array, in preorder. A node's
+ * first child immediately follows it and its next sibling is size entries
+ * further on, so the subtree rooted at i is exactly [i, i + size) and can be
+ * skipped in O(1). payload is the interned name of an AST_IDENT node and the
+ * index into nums of an AST_NUM node.
+ */
+typedef struct {
+    uint8_t label; // ast_label_t
+    uint32_t payload;
+    uint32_t size; // nodes in the subtree, including this one
+} flat_node_t;
+
+typedef struct {
+    flat_node_t* nodes;
+    size_t count;
+    int64_t* nums;
+    size_t num_count;
+} flat_ast_t;
+
+bool flatten_ast(ast_node_t* root, size_t node_count, flat_ast_t* flat);
+
+void free_flat_ast(flat_ast_t* flat);
+
+/* One past the last node of the subtree rooted at i */
+static inline size_t flat_end(const flat_ast_t* ast, size_t i)
+{
+    return i + ast->nodes[i].size;
+}
+
+static inline size_t flat_first_child(size_t i)
+{
+    return i + 1;
+}
+
+static inline size_t flat_next_sibling(const flat_ast_t* ast, size_t i)
+{
+    return i + ast->nodes[i].size;
+}
+
+static inline ast_label_t flat_label(const flat_ast_t* ast, size_t i)
+{
+    return (ast_label_t)ast->nodes[i].label;
+}
+
+static inline uint32_t flat_ident(const flat_ast_t* ast, size_t i)
+{
+    return ast->nodes[i].payload;
+}
+
+static inline int64_t flat_num(const flat_ast_t* ast, size_t i)
+{
+    return ast->nums[ast->nodes[i].payload];
+}
+
+/* Iterate over the direct children of node parent */
+#define FOR_EACH_CHILD(ast, parent, child)                                      \
+    for (size_t child = flat_first_child(parent); child < flat_end(ast, parent); \
+         child = flat_next_sibling(ast, child))
 
 #endif
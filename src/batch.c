@@ -0,0 +1,775 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+/*
+ * Batch driver. Workers take the next file off a shared counter, so a slow
+ * file never holds up the rest of the queue. Each worker owns one
+ * pl0c_context_t, and with it one LLVM context, for its whole lifetime.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <llvm-c/Core.h>
+
+#include "../runtime/buffers.h"
+#include "../runtime/pl0rt.h"
+#include "batch.h"
+#include "pl0c.h"
+#include "source.h"
+
+extern char** environ;
+
+typedef struct {
+    const char* path;
+    size_t bytes;
+    bool ok;
+    char* messages; // errors to print for this file, NULL if none
+    size_t messages_len;
+    int worker;          // the thread that compiled it, from 0
+    bool compiled;       // not a cache hit, so stats and the context's events
+    pl0c_stats_t stats;  // are of this file
+    double link_start;   // when linking its executable began
+    double link_seconds; // 0 if no executable was linked
+    char* trace; // its Chrome trace events, comma first, with output->time_trace
+    size_t trace_len;
+} batch_file_t;
+
+typedef struct {
+    batch_file_t* files;
+    size_t count;
+    const pl0c_options_t* options;
+    const output_t* output;
+    atomic_size_t next;
+    atomic_int workers;
+} batch_t;
+
+bool add_file(file_list_t* files, const char* path)
+{
+    if (files->count == files->capacity) {
+        size_t capacity = files->capacity ? files->capacity * 2 : 16;
+        char** paths = realloc(files->paths, capacity * sizeof(char*));
+        if (!paths)
+            return false;
+        files->paths = paths;
+        files->capacity = capacity;
+    }
+
+    char* copy = strdup(path);
+    if (!copy)
+        return false;
+    files->paths[files->count++] = copy;
+    return true;
+}
+
+/* Paths in a response file are separated by whitespace */
+bool read_response_file(file_list_t* files, const char* path)
+{
+    source_t source;
+    if (!load_source(path, &source))
+        return false;
+
+    bool ok = true;
+    const char* p = source.text;
+    const char* end = source.text + source.len;
+    char* name = NULL;
+
+    while (ok && p < end) {
+        while (p < end && isspace((unsigned char)*p))
+            p++;
+        const char* start = p;
+        while (p < end && !isspace((unsigned char)*p))
+            p++;
+        if (p == start)
+            break;
+
+        name = strndup(start, p - start);
+        ok = name && add_file(files, name);
+        free(name);
+    }
+
+    release_source(&source);
+    return ok;
+}
+
+void free_file_list(file_list_t* files)
+{
+    for (size_t i = 0; i < files->count; i++) {
+        free(files->paths[i]);
+    }
+    free(files->paths);
+    files->paths = NULL;
+    files->count = files->capacity = 0;
+}
+
+/*
+ * Name of the file written for source path: <name>.pl0 or <name>.bc becomes
+ * <name>.ll, <name>.bc, <name>.s, <name>.o or <name> unless -o gave one. Text
+ * read from stdin is written to stdout, binary output to a.bc, a.o or a.out.
+ */
+static char* output_name(const char* path, const output_t* output)
+{
+    static const char* extensions[] = {
+        [PL0C_EMIT_LLVM] = ".ll",
+        [PL0C_EMIT_BITCODE] = ".bc",
+        [PL0C_EMIT_ASM] = ".s",
+        [PL0C_EMIT_OBJECT] = ".o",
+    };
+
+    if (output->path)
+        return strdup(output->path);
+
+    if (strcmp(path, "-") == 0) {
+        if (output->link)
+            return strdup("a.out");
+        if (output->emit == PL0C_EMIT_BITCODE || output->emit == PL0C_EMIT_OBJECT)
+            return strdup(output->emit == PL0C_EMIT_OBJECT ? "a.o" : "a.bc");
+        return strdup("-");
+    }
+
+    size_t len = strlen(path);
+    const char* extension = output->link ? ".out" : extensions[output->emit];
+    if (len >= 4 && strcmp(path + len - 4, ".pl0") == 0) {
+        len -= 4;
+        if (output->link)
+            extension = "";
+    } else if (len >= 3 && strcmp(path + len - 3, ".bc") == 0) {
+        len -= 3;
+        if (output->link)
+            extension = "";
+    }
+
+    size_t extension_len = strlen(extension);
+    char* name = malloc(len + extension_len + 1);
+    if (name) {
+        memcpy(name, path, len);
+        memcpy(name + len, extension, extension_len + 1);
+    }
+    return name;
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Run the C compiler driver to link objects with the runtime into executable,
+ * the output of file
+ */
+static bool link_executable(batch_file_t* file, char* const* objects,
+                            size_t object_count, const char* executable,
+                            const output_t* output, FILE* out)
+{
+    if (access(output->runtime, R_OK) != 0) {
+        fprintf(out, "error: runtime library %s not found\n", output->runtime);
+        return false;
+    }
+
+    char** argv = malloc((object_count + 5) * sizeof(char*));
+    if (!argv) {
+        fprintf(out, "error: out of memory\n");
+        return false;
+    }
+    size_t argc = 0;
+    argv[argc++] = (char*)output->linker;
+    argv[argc++] = "-o";
+    argv[argc++] = (char*)executable;
+    for (size_t i = 0; i < object_count; i++) {
+        argv[argc++] = objects[i];
+    }
+    argv[argc++] = (char*)output->runtime;
+    argv[argc] = NULL;
+
+    pid_t pid;
+    int status;
+    file->link_start = now();
+    int error = posix_spawnp(&pid, output->linker, NULL, NULL, argv, environ);
+    free(argv);
+    if (error) {
+        fprintf(out, "error: cannot run %s: %s\n", output->linker, strerror(error));
+        return false;
+    }
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            fprintf(out, "error: lost track of %s\n", output->linker);
+            return false;
+        }
+    }
+    file->link_seconds = now() - file->link_start;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(out, "error: linking %s failed\n", executable);
+        return false;
+    }
+    return true;
+}
+
+/* Write module in the requested form, going through a temporary object to link */
+static bool write_output(pl0c_context_t* ctx, batch_file_t* file,
+                         LLVMModuleRef module, const char* target,
+                         const output_t* output, FILE* out)
+{
+    if (!output->link)
+        return pl0c_emit_module(ctx, module, output->emit, target);
+
+    const char* dir = getenv("TMPDIR");
+    char object[4096];
+    snprintf(object, sizeof(object), "%s/pl0c-XXXXXX", dir && *dir ? dir : "/tmp");
+    int fd = mkstemp(object);
+    if (fd < 0) {
+        fprintf(out, "error: cannot create a temporary file in %s\n",
+                dir && *dir ? dir : "/tmp");
+        return false;
+    }
+    close(fd);
+
+    char* objects[] = { object };
+    bool ok = pl0c_emit_module(ctx, module, PL0C_EMIT_OBJECT, object) &&
+              link_executable(file, objects, 1, target, output, out);
+    unlink(object);
+    return ok;
+}
+
+/* Write the output from a file emitted earlier, by copying or linking it */
+static bool write_from(batch_file_t* file, const char* emitted, const char* target,
+                       const output_t* output, FILE* out)
+{
+    if (output->link) {
+        char* objects[] = { (char*)emitted };
+        return link_executable(file, objects, 1, target, output, out);
+    }
+    if (!copy_file(emitted, target)) {
+        fprintf(out, "error: cannot write %s\n", target);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Emit module into a new cache entry and write the output from there. Falls
+ * back to writing it directly if the cache can't take it.
+ */
+static bool write_through_cache(pl0c_context_t* ctx, batch_file_t* file,
+                                LLVMModuleRef module, const char* entry,
+                                const char* target, const output_t* output,
+                                FILE* out)
+{
+    char* temporary = cache_temporary(output->cache);
+    if (!temporary)
+        return write_output(ctx, file, module, target, output, out);
+
+    pl0c_emit_t kind = output->link ? PL0C_EMIT_OBJECT : output->emit;
+    bool ok = pl0c_emit_module(ctx, module, kind, temporary);
+    if (ok && cache_store(temporary, entry)) {
+        ok = write_from(file, entry, target, output, out);
+    } else if (ok) {
+        ok = write_output(ctx, file, module, target, output, out);
+    } else {
+        unlink(temporary);
+    }
+    free(temporary);
+    return ok;
+}
+
+/*
+ * A .bc file, or anything starting like bitcode: 'BC' 0xc0de, or 0x0b17c0de
+ * when wrapped
+ */
+static bool is_bitcode(const char* path, const char* text, size_t len)
+{
+    size_t path_len = strlen(path);
+    if (path_len >= 3 && strcmp(path + path_len - 3, ".bc") == 0)
+        return true;
+    return len >= 4 && (memcmp(text, "BC\xc0\xde", 4) == 0 ||
+                        memcmp(text, "\xde\xc0\x17\x0b", 4) == 0);
+}
+
+/* Compile PL/0 source, or read a module from bitcode */
+static LLVMModuleRef compile_source(pl0c_context_t* ctx, const char* path,
+                                    const source_t* source)
+{
+    if (is_bitcode(path, source->text, source->len))
+        return pl0c_load_bitcode(ctx, path, source->text, source->len);
+    return pl0c_compile_module(ctx, path, source->text, source->len);
+}
+
+/* pl0c_unit_store_t of the objects in the cache */
+static bool cache_has_unit(void* user, const char* key)
+{
+    cache_t* cache = user;
+    char* entry = cache_entry(cache, key, PL0C_EMIT_OBJECT);
+    bool hit = entry && cache_lookup(cache, entry);
+    free(entry);
+    return hit;
+}
+
+static bool cache_store_unit(void* user, const char* key, const char* object,
+                             size_t size)
+{
+    cache_t* cache = user;
+    char* entry = cache_entry(cache, key, PL0C_EMIT_OBJECT);
+    bool ok = entry && cache_write(cache, entry, object, size);
+    free(entry);
+    return ok;
+}
+
+/*
+ * Link the executable of source from an object per procedure, generating
+ * only those the cache doesn't have yet
+ */
+static bool compile_units(pl0c_context_t* ctx, batch_file_t* file,
+                          const source_t* source, const output_t* output,
+                          FILE* out)
+{
+    char* target = output_name(file->path, output);
+    if (!target) {
+        fprintf(out, "%s: error: out of memory\n", file->path);
+        return false;
+    }
+    if (strcmp(target, file->path) == 0) {
+        fprintf(out, "%s: error: output would overwrite the input\n", file->path);
+        free(target);
+        return false;
+    }
+
+    pl0c_unit_store_t store = { cache_has_unit, cache_store_unit, output->cache };
+    char* keys;
+    size_t count;
+    bool ok = pl0c_compile_units(ctx, file->path, source->text, source->len, &store,
+                                 &keys, &count);
+    file->compiled = true;
+    file->stats = *pl0c_stats(ctx);
+    if (!ok) {
+        free(target);
+        return false;
+    }
+
+    char** objects = calloc(count, sizeof(char*));
+    ok = objects != NULL;
+    for (size_t i = 0; ok && i < count; i++) {
+        objects[i] =
+            cache_entry(output->cache, &keys[i * (PL0C_UNIT_KEY_LEN + 1)],
+                        PL0C_EMIT_OBJECT);
+        ok = objects[i] != NULL;
+    }
+    if (ok)
+        ok = link_executable(file, objects, count, target, output, out);
+    else
+        fprintf(out, "%s: error: out of memory\n", file->path);
+
+    for (size_t i = 0; objects && i < count; i++) {
+        free(objects[i]);
+    }
+    free(objects);
+    free(keys);
+    free(target);
+    return ok;
+}
+
+/* s as a JSON string */
+static void write_json_string(FILE* f, const char* s)
+{
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+/* A complete trace event up to its arguments, in microseconds */
+static void begin_trace_event(FILE* f, const char* name, int worker, double start,
+                              double seconds)
+{
+    fprintf(f, ",\n{\"name\":");
+    write_json_string(f, name);
+    fprintf(f,
+            ",\"cat\":\"pl0c\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+            "\"ts\":%.3f,\"dur\":%.3f",
+            worker, start * 1e6, seconds * 1e6);
+}
+
+/*
+ * Trace events of file, compiled from start to end: the whole compilation
+ * with its counters, the phases ctx recorded and linking
+ */
+static void trace_file(pl0c_context_t* ctx, batch_file_t* file, double start,
+                       double end)
+{
+    FILE* f = open_memstream(&file->trace, &file->trace_len);
+    if (!f)
+        return;
+
+    const pl0c_stats_t* s = &file->stats;
+    begin_trace_event(f, "compile", file->worker, start, end - start);
+    fprintf(f, ",\"args\":{\"detail\":");
+    write_json_string(f, file->path);
+    fprintf(f,
+            ",\"tokens\":%zu,\"ast_nodes\":%zu,\"symbols\":%zu,"
+            "\"instructions\":%zu,\"optimized_instructions\":%zu}}",
+            s->tokens, s->ast_nodes, s->symbols, s->instructions,
+            s->optimized_instructions);
+
+    for (size_t i = 0; file->compiled && i < pl0c_event_count(ctx); i++) {
+        pl0c_event_t event = pl0c_event(ctx, i);
+        begin_trace_event(f, event.name, file->worker, event.start, event.seconds);
+        if (event.detail) {
+            fprintf(f, ",\"args\":{\"detail\":");
+            write_json_string(f, event.detail);
+            fputc('}', f);
+        }
+        fputc('}', f);
+    }
+
+    if (file->link_seconds) {
+        begin_trace_event(f, "link", file->worker, file->link_start,
+                          file->link_seconds);
+        fputc('}', f);
+    }
+    fclose(f);
+}
+
+static void compile_file(pl0c_context_t* ctx, batch_file_t* file,
+                         const pl0c_options_t* options, const output_t* output)
+{
+    FILE* out = open_memstream(&file->messages, &file->messages_len);
+    if (!out)
+        return;
+    double start = now();
+
+    source_t source;
+    if (!ctx) {
+        fprintf(out, "%s: error: out of memory\n", file->path);
+    } else if (!load_source(file->path, &source)) {
+        fprintf(out, "error: %s not found\n", file->path);
+    } else if (output->incremental &&
+               !is_bitcode(file->path, source.text, source.len)) {
+        file->bytes = source.len;
+        file->ok = compile_units(ctx, file, &source, output, out);
+        release_source(&source);
+
+        for (size_t i = 0; !file->ok && i < pl0c_error_count(ctx); i++) {
+            fprintf(out, "%s: %s\n", file->path, pl0c_error_message(ctx, i));
+        }
+        for (size_t i = 0; output->remarks && i < pl0c_remark_count(ctx); i++) {
+            fprintf(out, "%s: %s\n", file->path, pl0c_remark_message(ctx, i));
+        }
+    } else {
+        file->bytes = source.len;
+
+        /* remarks come from compiling, so they are never cached */
+        char* entry = NULL;
+        if (output->cache && !output->remarks) {
+            pl0c_emit_t kind = output->link ? PL0C_EMIT_OBJECT : output->emit;
+            char key[CACHE_KEY_LEN + 1];
+            cache_key(output->cache, file->path, source.text, source.len, options,
+                      kind, key);
+            entry = cache_entry(output->cache, key, kind);
+        }
+        bool hit = entry && cache_lookup(output->cache, entry);
+
+        LLVMModuleRef module = hit ? NULL : compile_source(ctx, file->path, &source);
+        release_source(&source);
+
+        char* target = module || hit ? output_name(file->path, output) : NULL;
+        if ((module || hit) && !target) {
+            fprintf(out, "%s: error: out of memory\n", file->path);
+        } else if ((module || hit) && strcmp(target, "-") &&
+                   strcmp(target, file->path) == 0) {
+            fprintf(out, "%s: error: output would overwrite the input\n",
+                    file->path);
+        } else if (hit) {
+            file->ok = write_from(file, entry, target, output, out);
+        } else if (module && entry) {
+            file->ok =
+                write_through_cache(ctx, file, module, entry, target, output, out);
+        } else if (module) {
+            file->ok = write_output(ctx, file, module, target, output, out);
+        }
+
+        /* emitting is part of compiling */
+        file->compiled = !hit;
+        if (!hit)
+            file->stats = *pl0c_stats(ctx);
+
+        /* errors of compiling or emitting; a hit did neither */
+        for (size_t i = 0; !hit && !file->ok && i < pl0c_error_count(ctx); i++) {
+            fprintf(out, "%s: %s\n", file->path, pl0c_error_message(ctx, i));
+        }
+        for (size_t i = 0; output->remarks && i < pl0c_remark_count(ctx); i++) {
+            fprintf(out, "%s: %s\n", file->path, pl0c_remark_message(ctx, i));
+        }
+
+        if (module)
+            LLVMDisposeModule(module);
+        free(target);
+        free(entry);
+    }
+
+    fclose(out);
+    if (ctx && output->time_trace)
+        trace_file(ctx, file, start, now());
+}
+
+static void* worker(void* arg)
+{
+    batch_t* batch = arg;
+    int index = atomic_fetch_add(&batch->workers, 1);
+    pl0c_context_t* ctx = pl0c_create_context();
+    if (ctx)
+        pl0c_set_options(ctx, batch->options);
+
+    for (;;) {
+        size_t i = atomic_fetch_add(&batch->next, 1);
+        if (i >= batch->count)
+            break;
+        batch->files[i].worker = index;
+        compile_file(ctx, &batch->files[i], batch->options, batch->output);
+    }
+
+    pl0c_destroy_context(ctx);
+    return NULL;
+}
+
+static double peak_rss_mb()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return usage.ru_maxrss / 1e3; // kilobytes on Linux
+}
+
+/* Where the time of the whole batch went, phase by phase, and what was made */
+static void print_stats(const batch_t* batch)
+{
+    static const struct {
+        const char* name;
+        size_t offset;
+    } phases[] = {
+        { "scan", offsetof(pl0c_stats_t, scan_seconds) },
+        { "parse", offsetof(pl0c_stats_t, parse_seconds) },
+        { "drop_uncalled", offsetof(pl0c_stats_t, prune_seconds) },
+        { "run_semantic_checks", offsetof(pl0c_stats_t, check_seconds) },
+        { "fold_constants", offsetof(pl0c_stats_t, fold_seconds) },
+        { "generate_code", offsetof(pl0c_stats_t, generate_seconds) },
+        { "verify", offsetof(pl0c_stats_t, verify_seconds) },
+        { "optimize", offsetof(pl0c_stats_t, optimize_seconds) },
+        { "emit", offsetof(pl0c_stats_t, emit_seconds) },
+    };
+    size_t phase_count = sizeof(phases) / sizeof(phases[0]);
+
+    double seconds[sizeof(phases) / sizeof(phases[0]) + 1] = { 0 };
+    pl0c_stats_t total = { 0 };
+    for (size_t i = 0; i < batch->count; i++) {
+        const pl0c_stats_t* s = &batch->files[i].stats;
+        for (size_t p = 0; p < phase_count; p++) {
+            seconds[p] += *(const double*)((const char*)s + phases[p].offset);
+        }
+        seconds[phase_count] += batch->files[i].link_seconds;
+        total.tokens += s->tokens;
+        total.ast_nodes += s->ast_nodes;
+        total.symbols += s->symbols;
+        total.instructions += s->instructions;
+        total.optimized_instructions += s->optimized_instructions;
+    }
+    double sum = 0;
+    for (size_t p = 0; p <= phase_count; p++) {
+        sum += seconds[p];
+    }
+
+    fprintf(stderr, "pl0c: %-21s %9s %6s\n", "phase", "seconds", "share");
+    for (size_t p = 0; p <= phase_count; p++) {
+        fprintf(stderr, "pl0c:   %-19s %9.4f %5.1f%%\n",
+                p < phase_count ? phases[p].name : "link", seconds[p],
+                sum > 0 ? 100 * seconds[p] / sum : 0.0);
+    }
+    fprintf(stderr,
+            "pl0c: %zu tokens, %zu AST nodes, %zu symbols, %zu IR instructions "
+            "generated, %zu after optimizing\n",
+            total.tokens, total.ast_nodes, total.symbols, total.instructions,
+            total.optimized_instructions);
+    fprintf(stderr, "pl0c: peak RSS %.1f MB\n", peak_rss_mb());
+}
+
+/*
+ * The trace events of every file in the Chrome trace event format, with a
+ * thread per worker and the peak RSS as a counter at the end
+ */
+static bool write_trace(const char* path, const batch_t* batch, int workers)
+{
+    FILE* f = fopen(path, "w");
+    if (!f)
+        return false;
+
+    fprintf(f, "{\"traceEvents\":[\n"
+               "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+               "\"args\":{\"name\":\"pl0c\"}}");
+    for (int i = 0; i < workers; i++) {
+        fprintf(f,
+                ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%d,\"args\":{\"name\":\"worker %d\"}}",
+                i, i);
+    }
+    for (size_t i = 0; i < batch->count; i++) {
+        const batch_file_t* file = &batch->files[i];
+        if (file->trace_len)
+            fwrite(file->trace, 1, file->trace_len, f);
+    }
+    fprintf(f,
+            ",\n{\"name\":\"peak RSS\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,"
+            "\"args\":{\"MB\":%.1f}}\n],\"displayTimeUnit\":\"ms\"}\n",
+            now() * 1e6, peak_rss_mb());
+    return fclose(f) == 0;
+}
+
+size_t compile_batch(const file_list_t* files, const pl0c_options_t* options,
+                     const output_t* output, int jobs, bool report)
+{
+    if (jobs <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cpus > 0 ? (int)cpus : 1;
+    }
+    if ((size_t)jobs > files->count)
+        jobs = files->count ? (int)files->count : 1;
+
+    batch_t batch;
+    batch.files = calloc(files->count, sizeof(batch_file_t));
+    batch.count = files->count;
+    batch.options = options;
+    batch.output = output;
+    atomic_init(&batch.next, 0);
+    atomic_init(&batch.workers, 0);
+    if (!batch.files && files->count) {
+        fprintf(stderr, "error: out of memory\n");
+        return files->count;
+    }
+    for (size_t i = 0; i < files->count; i++) {
+        batch.files[i].path = files->paths[i];
+    }
+
+    double start = now();
+
+    /* the calling thread is the first worker */
+    pthread_t* threads = calloc(jobs, sizeof(pthread_t));
+    int started = 1;
+    while (threads && started < jobs &&
+           pthread_create(&threads[started], NULL, worker, &batch) == 0) {
+        started++;
+    }
+    worker(&batch);
+    for (int i = 1; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    double elapsed = now() - start;
+
+    size_t failed = 0;
+    size_t bytes = 0;
+    double optimize_seconds = 0;
+    for (size_t i = 0; i < batch.count; i++) {
+        batch_file_t* file = &batch.files[i];
+        if (file->messages_len) {
+            fwrite(file->messages, 1, file->messages_len, stderr);
+        }
+        free(file->messages);
+        failed += !file->ok;
+        bytes += file->bytes;
+        optimize_seconds += file->stats.optimize_seconds;
+    }
+
+    if (options->stats)
+        print_stats(&batch);
+    if (output->time_trace && !write_trace(output->time_trace, &batch, started)) {
+        fprintf(stderr, "error: cannot write %s\n", output->time_trace);
+        failed = failed ? failed : 1;
+    }
+    for (size_t i = 0; i < batch.count; i++) {
+        free(batch.files[i].trace);
+    }
+    free(batch.files);
+
+    if (report) {
+        fprintf(stderr,
+                "pl0c: %zu files, %zu failed, %.1f MB in %.3f s with %d jobs "
+                "(%.1f files/s, %.1f MB/s)\n",
+                batch.count, failed, bytes / 1e6, elapsed, started,
+                batch.count / elapsed, bytes / 1e6 / elapsed);
+        if (options->opt_level || options->passes) {
+            fprintf(stderr, "pl0c: optimizing took %.3f s, %.1f%% of compile time\n",
+                    optimize_seconds,
+                    100 * optimize_seconds / (elapsed * started));
+        }
+    }
+
+    /* cache statistics are printed whenever the cache is in use */
+    if (output->cache) {
+        cache_t* cache = output->cache;
+        uint64_t used = trim_cache(cache);
+        fprintf(stderr, "pl0c: cache: %zu hits, %zu misses, %.1f of %.1f MB used\n",
+                atomic_load(&cache->hits), atomic_load(&cache->misses), used / 1e6,
+                cache->max_bytes / 1e6);
+    }
+    return failed;
+}
+
+bool run_file(const char* path, const pl0c_options_t* options, int* status)
+{
+    /* optimized modules carry their own print64 and scan64, which use the rest */
+    const pl0c_symbol_t runtime[] = {
+        { "print64", (void*)print64 },
+        { "scan64", (void*)scan64 },
+        { "pl0rt_buffers", &pl0rt_buffers },
+        { "pl0rt_flush", (void*)pl0rt_flush },
+        { "pl0rt_start_output", (void*)pl0rt_start_output },
+        { "pl0rt_refill", (void*)pl0rt_refill },
+    };
+
+    pl0c_context_t* ctx = pl0c_create_context();
+    if (!ctx) {
+        fprintf(stderr, "error: out of memory\n");
+        return false;
+    }
+    pl0c_set_options(ctx, options);
+
+    bool ok = false;
+    source_t source;
+    if (!load_source(path, &source)) {
+        fprintf(stderr, "error: %s not found\n", path);
+    } else {
+        LLVMModuleRef module = compile_source(ctx, path, &source);
+        release_source(&source);
+        ok = module && pl0c_run_module(ctx, module, runtime,
+                                       sizeof(runtime) / sizeof(runtime[0]), status);
+        pl0rt_flush();
+        for (size_t i = 0; !ok && i < pl0c_error_count(ctx); i++) {
+            fprintf(stderr, "%s: %s\n", path, pl0c_error_message(ctx, i));
+        }
+    }
+
+    pl0c_destroy_context(ctx);
+    return ok;
+}
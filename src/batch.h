@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cache.h"
+#include "pl0c.h"
+
+/* Source files named on the command line or in response files */
+typedef struct {
+    char** paths;
+    size_t count;
+    size_t capacity;
+} file_list_t;
+
+bool add_file(file_list_t* files, const char* path);
+
+bool read_response_file(file_list_t* files, const char* path);
+
+void free_file_list(file_list_t* files);
+
+/* What to write for each source file */
+typedef struct {
+    bool link;           // build an executable from the object file
+    pl0c_emit_t emit;    // what to write when not linking
+    const char* path;    // -o, for a single source file
+    const char* runtime; // runtime library linked into executables
+    const char* linker;  // C compiler driver that links executables
+    bool remarks;        // print remarks along with errors
+    cache_t* cache;      // where to look for output first, or NULL
+    bool incremental;    // link executables from cached objects per procedure
+    const char* time_trace; // Chrome trace event file to write, or NULL
+} output_t;
+
+/*
+ * Compile every file with options on a pool of jobs worker threads (0 means
+ * one per online CPU), writing output next to each source. Errors are
+ * printed per file in input order. With report set, a throughput summary
+ * follows, and with options->stats the time of each phase. Returns the
+ * number of files that failed.
+ */
+size_t compile_batch(const file_list_t* files, const pl0c_options_t* options,
+                     const output_t* output, int jobs, bool report);
+
+/*
+ * Compile one file with options and run it in-process, with stdin and stdout
+ * shared with pl0c. On success *status holds the exit status of the program.
+ */
+bool run_file(const char* path, const pl0c_options_t* options, int* status);
+
+#endif
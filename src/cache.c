@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <llvm-c/TargetMachine.h>
+#include <llvm/Config/llvm-config.h>
+
+#include "cache.h"
+#include "hash.h"
+
+#define STALE_SECONDS 3600 // temporary files older than this were abandoned
+
+static const char* extension(pl0c_emit_t kind)
+{
+    static const char* extensions[] = {
+        [PL0C_EMIT_LLVM] = "ll",
+        [PL0C_EMIT_BITCODE] = "bc",
+        [PL0C_EMIT_ASM] = "s",
+        [PL0C_EMIT_OBJECT] = "o",
+    };
+    return extensions[kind];
+}
+
+/* mkdir -p */
+static bool make_dirs(const char* dir)
+{
+    char* path = strdup(dir);
+    if (!path)
+        return false;
+
+    bool ok = true;
+    for (char* p = path + 1; ok; p++) {
+        if (*p != '/' && *p != '\0')
+            continue;
+        char c = *p;
+        *p = '\0';
+        ok = mkdir(path, 0755) == 0 || errno == EEXIST;
+        *p = c;
+        if (c == '\0')
+            break;
+    }
+    free(path);
+    return ok;
+}
+
+bool open_cache(cache_t* cache, const char* dir, uint64_t max_bytes)
+{
+    memset(cache, 0, sizeof(*cache));
+    atomic_init(&cache->hits, 0);
+    atomic_init(&cache->misses, 0);
+    if (!make_dirs(dir) || access(dir, R_OK | W_OK | X_OK) != 0)
+        return false;
+
+    /* objects and assembly are generated for the host CPU */
+    char* triple = LLVMGetDefaultTargetTriple();
+    char* cpu = LLVMGetHostCPUName();
+    char* features = LLVMGetHostCPUFeatures();
+    size_t len = strlen(triple) + strlen(cpu) + strlen(features) + 3;
+    cache->target = malloc(len);
+    if (cache->target)
+        snprintf(cache->target, len, "%s %s %s", triple, cpu, features);
+    LLVMDisposeMessage(triple);
+    LLVMDisposeMessage(cpu);
+    LLVMDisposeMessage(features);
+
+    cache->dir = strdup(dir);
+    cache->max_bytes = max_bytes;
+    if (!cache->dir || !cache->target) {
+        close_cache(cache);
+        return false;
+    }
+    return true;
+}
+
+void close_cache(cache_t* cache)
+{
+    free(cache->dir);
+    free(cache->target);
+    cache->dir = NULL;
+    cache->target = NULL;
+}
+
+static char* join(const char* dir, const char* name)
+{
+    size_t len = strlen(dir) + strlen(name) + 2;
+    char* path = malloc(len);
+    if (path)
+        snprintf(path, len, "%s/%s", dir, name);
+    return path;
+}
+
+char* default_cache_dir(void)
+{
+    const char* dir = getenv("PL0C_CACHE_DIR");
+    if (dir && *dir)
+        return strdup(dir);
+    dir = getenv("XDG_CACHE_HOME");
+    if (dir && *dir)
+        return join(dir, "pl0c");
+    dir = getenv("HOME");
+    if (dir && *dir)
+        return join(dir, ".cache/pl0c");
+    return NULL;
+}
+
+void cache_key(const cache_t* cache, const char* name, const char* text, size_t len,
+               const pl0c_options_t* options, pl0c_emit_t kind,
+               char key[CACHE_KEY_LEN + 1])
+{
+    hasher_t h;
+    init_hasher(&h);
+
+    hash_string(&h, PL0C_VERSION);
+    hash_string(&h, LLVM_VERSION_STRING);
+    hash_string(&h, cache->target);
+    /* the name is recorded in the output, as the module's source file name */
+    hash_string(&h, name);
+
+    int flags[] = { options->opt_level, options->ssa, options->whole_program,
+                    options->strict_overflow, kind };
+    hash_field(&h, flags, sizeof(flags));
+    hash_string(&h, options->passes);
+
+    hash_field(&h, text, len);
+
+    hash_hex(&h, key);
+}
+
+char* cache_entry(const cache_t* cache, const char* key, pl0c_emit_t kind)
+{
+    char name[CACHE_KEY_LEN + 4];
+    snprintf(name, sizeof(name), "%s.%s", key, extension(kind));
+    return join(cache->dir, name);
+}
+
+bool cache_lookup(cache_t* cache, const char* entry)
+{
+    /* the modification time is the last use */
+    if (utimensat(AT_FDCWD, entry, NULL, 0) == 0) {
+        atomic_fetch_add(&cache->hits, 1);
+        return true;
+    }
+    atomic_fetch_add(&cache->misses, 1);
+    return false;
+}
+
+char* cache_temporary(const cache_t* cache)
+{
+    char* path = join(cache->dir, "tmp-XXXXXX");
+    if (!path)
+        return NULL;
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        free(path);
+        return NULL;
+    }
+    close(fd);
+    return path;
+}
+
+bool cache_store(const char* temporary, const char* entry)
+{
+    if (rename(temporary, entry) == 0)
+        return true;
+    unlink(temporary);
+    return false;
+}
+
+bool cache_write(const cache_t* cache, const char* entry, const char* data,
+                 size_t size)
+{
+    char* temporary = cache_temporary(cache);
+    if (!temporary)
+        return false;
+
+    FILE* file = fopen(temporary, "wb");
+    bool ok = file && fwrite(data, 1, size, file) == size;
+    if (file && fclose(file) != 0)
+        ok = false;
+    ok = ok ? cache_store(temporary, entry) : (unlink(temporary), false);
+    free(temporary);
+    return ok;
+}
+
+typedef struct {
+    char* path;
+    uint64_t size;
+    struct timespec used;
+} cached_file_t;
+
+static int least_recent_first(const void* lhs, const void* rhs)
+{
+    const struct timespec* a = &((const cached_file_t*)lhs)->used;
+    const struct timespec* b = &((const cached_file_t*)rhs)->used;
+    if (a->tv_sec != b->tv_sec)
+        return a->tv_sec < b->tv_sec ? -1 : 1;
+    if (a->tv_nsec != b->tv_nsec)
+        return a->tv_nsec < b->tv_nsec ? -1 : 1;
+    return 0;
+}
+
+uint64_t trim_cache(const cache_t* cache)
+{
+    DIR* dir = opendir(cache->dir);
+    if (!dir)
+        return 0;
+
+    cached_file_t* files = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    uint64_t total = 0;
+    time_t now = time(NULL);
+
+    struct dirent* d;
+    while ((d = readdir(dir))) {
+        if (d->d_name[0] == '.')
+            continue;
+        char* path = join(cache->dir, d->d_name);
+        struct stat st;
+        if (!path || stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            free(path);
+            continue;
+        }
+
+        /* another compilation may still be writing a temporary file */
+        if (strncmp(d->d_name, "tmp-", 4) == 0) {
+            if (now - st.st_mtim.tv_sec > STALE_SECONDS)
+                unlink(path);
+            free(path);
+            continue;
+        }
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            cached_file_t* grown = realloc(files, capacity * sizeof(cached_file_t));
+            if (!grown) {
+                free(path);
+                break;
+            }
+            files = grown;
+        }
+        files[count++] = (cached_file_t){ path, st.st_size, st.st_mtim };
+        total += st.st_size;
+    }
+    closedir(dir);
+
+    if (total > cache->max_bytes)
+        qsort(files, count, sizeof(cached_file_t), least_recent_first);
+    for (size_t i = 0; i < count; i++) {
+        if (total > cache->max_bytes && unlink(files[i].path) == 0)
+            total -= files[i].size;
+        free(files[i].path);
+    }
+    free(files);
+    return total;
+}
+
+bool copy_file(const char* from, const char* to)
+{
+    int in = open(from, O_RDONLY);
+    if (in < 0)
+        return false;
+    bool to_stdout = strcmp(to, "-") == 0;
+    int out =
+        to_stdout ? STDOUT_FILENO : open(to, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (out < 0) {
+        close(in);
+        return false;
+    }
+
+    char buf[1 << 16];
+    bool ok = true;
+    for (;;) {
+        ssize_t n = read(in, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            ok = n == 0;
+            break;
+        }
+        for (ssize_t done = 0; ok && done < n;) {
+            ssize_t written = write(out, buf + done, n - done);
+            if (written < 0 && errno == EINTR)
+                continue;
+            ok = written > 0;
+            done += ok ? written : 0;
+        }
+        if (!ok)
+            break;
+    }
+
+    close(in);
+    if (!to_stdout && close(out) != 0)
+        ok = false;
+    return ok;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash.h"
+#include "pl0c.h"
+
+#define CACHE_KEY_LEN HASH_HEX_LEN
+
+/*
+ * On-disk cache of compiler output. Each entry is one emitted .ll, .bc, .s or
+ * .o file named after the hash of everything that went into it, so entries
+ * never go stale and are shared by any number of threads and processes.
+ * Entries are written to a temporary file and renamed into place. A hit
+ * refreshes the entry's modification time, and trim_cache() removes the
+ * least recently used entries beyond the size limit.
+ */
+typedef struct {
+    char* dir;
+    uint64_t max_bytes;
+    char* target; // triple, CPU and features of the host, part of every key
+    atomic_size_t hits;
+    atomic_size_t misses;
+} cache_t;
+
+/*
+ * Open the cache in dir, creating it if needed. Returns false if that is not
+ * possible.
+ */
+bool open_cache(cache_t* cache, const char* dir, uint64_t max_bytes);
+
+void close_cache(cache_t* cache);
+
+/* The cache directory: $PL0C_CACHE_DIR, $XDG_CACHE_HOME/pl0c or ~/.cache/pl0c */
+char* default_cache_dir(void);
+
+/* Key of the output of kind for the source text of name compiled with options */
+void cache_key(const cache_t* cache, const char* name, const char* text, size_t len,
+               const pl0c_options_t* options, pl0c_emit_t kind,
+               char key[CACHE_KEY_LEN + 1]);
+
+/* Path of the entry for key; NULL if out of memory. The caller frees it. */
+char* cache_entry(const cache_t* cache, const char* key, pl0c_emit_t kind);
+
+/* Whether entry exists, counting a hit or a miss; a hit marks it as used */
+bool cache_lookup(cache_t* cache, const char* entry);
+
+/*
+ * A new temporary file in the cache directory, to be written and then moved
+ * to its entry with cache_store(). NULL if it can't be created.
+ */
+char* cache_temporary(const cache_t* cache);
+
+/* Move the temporary file into place as entry */
+bool cache_store(const char* temporary, const char* entry);
+
+/* Store size bytes of data as entry, through a temporary file */
+bool cache_write(const cache_t* cache, const char* entry, const char* data,
+                 size_t size);
+
+/*
+ * Remove the least recently used entries until the cache fits its size limit.
+ * Returns the bytes left in use.
+ */
+uint64_t trim_cache(const cache_t* cache);
+
+/* Copy the file at from to the path to, or to stdout if to is "-" */
+bool copy_file(const char* from, const char* to);
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "callgraph.h"
+
+/* Mark everything reachable from the procedures already on stack */
+static void mark_reachable(call_graph_t* graph, uint32_t* stack, size_t depth)
+{
+    while (depth) {
+        cg_proc_t* proc = &graph->procs[stack[--depth]];
+        for (size_t i = 0; i < proc->callee_count; i++) {
+            uint32_t callee = graph->callees[proc->first_callee + i];
+            if (!graph->procs[callee].reachable) {
+                graph->procs[callee].reachable = true;
+                stack[depth++] = callee;
+            }
+        }
+    }
+}
+
+/* Depth first search state of one procedure in find_recursion() */
+typedef struct {
+    uint32_t proc;
+    size_t next_callee;
+} frame_t;
+
+/*
+ * Tarjan's strongly connected components, without recursion so a long call
+ * chain can't overflow the stack. A procedure is recursive if its component
+ * holds other procedures or it calls itself.
+ */
+static bool find_recursion(call_graph_t* graph)
+{
+    size_t n = graph->proc_count;
+    uint32_t* order = malloc((n + 1) * sizeof(uint32_t)); // 0 if not visited
+    uint32_t* low = malloc((n + 1) * sizeof(uint32_t));
+    uint32_t* component = malloc((n + 1) * sizeof(uint32_t));
+    frame_t* frames = malloc((n + 1) * sizeof(frame_t));
+    bool* on_component = calloc(n + 1, sizeof(bool));
+    bool ok = order && low && component && frames && on_component;
+
+    size_t visited = 0;
+    size_t component_size = 0;
+    for (size_t root = 0; ok && root < n; root++) {
+        order[root] = 0;
+    }
+
+    for (size_t root = 0; ok && root < n; root++) {
+        if (order[root])
+            continue;
+
+        size_t depth = 0;
+        frames[depth++] = (frame_t){ root, 0 };
+        order[root] = low[root] = ++visited;
+        component[component_size++] = root;
+        on_component[root] = true;
+
+        while (depth) {
+            frame_t* frame = &frames[depth - 1];
+            cg_proc_t* proc = &graph->procs[frame->proc];
+
+            if (frame->next_callee < proc->callee_count) {
+                uint32_t callee =
+                    graph->callees[proc->first_callee + frame->next_callee++];
+                if (callee == frame->proc) {
+                    proc->recursive = true;
+                } else if (!order[callee]) {
+                    order[callee] = low[callee] = ++visited;
+                    component[component_size++] = callee;
+                    on_component[callee] = true;
+                    frames[depth++] = (frame_t){ callee, 0 };
+                } else if (on_component[callee] &&
+                           order[callee] < low[frame->proc]) {
+                    low[frame->proc] = order[callee];
+                }
+                continue;
+            }
+
+            /* all callees done: close the component if frame->proc is its root */
+            uint32_t done = frame->proc;
+            depth--;
+            if (low[done] == order[done]) {
+                bool cycle = component[component_size - 1] != done;
+                uint32_t member;
+                do {
+                    member = component[--component_size];
+                    on_component[member] = false;
+                    graph->procs[member].recursive |= cycle;
+                } while (member != done);
+            }
+            if (depth && low[done] < low[frames[depth - 1].proc])
+                low[frames[depth - 1].proc] = low[done];
+        }
+    }
+
+    free(order);
+    free(low);
+    free(component);
+    free(frames);
+    free(on_component);
+    return ok;
+}
+
+bool build_call_graph(const flat_ast_t* ast, const intern_table_t* names,
+                      call_graph_t* graph)
+{
+    memset(graph, 0, sizeof(*graph));
+
+    size_t proc_count = 0;
+    size_t call_count = 0;
+    for (size_t i = 0; i < ast->count; i++) {
+        proc_count += flat_label(ast, i) == AST_PROC_DECL;
+        call_count += flat_label(ast, i) == AST_CALL;
+    }
+
+    /* procedure index + 1 for each interned name, 0 if it names none */
+    uint32_t* proc_of = calloc(interned_count(names) + 1, sizeof(uint32_t));
+    /* whether each interned name is a global CONST or VAR */
+    bool* global = calloc(interned_count(names) + 1, sizeof(bool));
+    uint32_t* stack = malloc((proc_count + 1) * sizeof(uint32_t));
+    graph->procs = malloc((proc_count + 1) * sizeof(cg_proc_t));
+    graph->callees = malloc((call_count + 1) * sizeof(uint32_t));
+    if (!proc_of || !global || !stack || !graph->procs || !graph->callees) {
+        free(proc_of);
+        free(global);
+        free(stack);
+        free_call_graph(graph);
+        return false;
+    }
+
+    FOR_EACH_CHILD(ast, 0, current)
+    {
+        ast_label_t label = flat_label(ast, current);
+        if (label != AST_CONST_DECL && label != AST_VAR_DECL)
+            continue;
+        FOR_EACH_CHILD(ast, current, name)
+        {
+            global[flat_ident(ast, name)] = true;
+        }
+    }
+
+    size_t depth = 0;
+    FOR_EACH_CHILD(ast, 0, current)
+    {
+        if (flat_label(ast, current) != AST_PROC_DECL)
+            continue;
+
+        cg_proc_t* proc = &graph->procs[graph->proc_count];
+        proc->name = flat_ident(ast, flat_first_child(current));
+        proc->node = current;
+        proc->reachable = false;
+        proc->recursive = false;
+
+        /* a redeclaration is kept, along with the first, to be reported */
+        if (proc_of[proc->name]) {
+            uint32_t first = proc_of[proc->name] - 1;
+            if (!graph->procs[first].reachable) {
+                graph->procs[first].reachable = true;
+                stack[depth++] = first;
+            }
+            proc->reachable = true;
+            stack[depth++] = graph->proc_count;
+        } else {
+            proc_of[proc->name] = graph->proc_count + 1;
+        }
+
+        /* and so is one named like a global CONST or VAR, for the same reason */
+        if (global[proc->name] && !proc->reachable) {
+            proc->reachable = true;
+            stack[depth++] = graph->proc_count;
+        }
+        graph->proc_count++;
+    }
+
+    /* Edges of each procedure, while main's calls go straight on the stack */
+    size_t proc = 0;
+    FOR_EACH_CHILD(ast, 0, current)
+    {
+        ast_label_t label = flat_label(ast, current);
+        if (label == AST_CONST_DECL || label == AST_VAR_DECL)
+            continue;
+
+        cg_proc_t* caller = label == AST_PROC_DECL ? &graph->procs[proc++] : NULL;
+        if (caller)
+            caller->first_callee = graph->callee_count;
+
+        for (size_t i = current; i < flat_end(ast, current); i++) {
+            if (flat_label(ast, i) != AST_CALL)
+                continue;
+            uint32_t callee = proc_of[flat_ident(ast, flat_first_child(i))];
+            if (!callee) {
+                continue;
+            } else if (caller) {
+                graph->callees[graph->callee_count++] = callee - 1;
+            } else if (!graph->procs[callee - 1].reachable) {
+                graph->procs[callee - 1].reachable = true;
+                stack[depth++] = callee - 1;
+            }
+        }
+
+        if (caller)
+            caller->callee_count = graph->callee_count - caller->first_callee;
+    }
+
+    mark_reachable(graph, stack, depth);
+
+    free(proc_of);
+    free(global);
+    free(stack);
+    if (!find_recursion(graph)) {
+        free_call_graph(graph);
+        return false;
+    }
+    return true;
+}
+
+void free_call_graph(call_graph_t* graph)
+{
+    free(graph->procs);
+    free(graph->callees);
+    memset(graph, 0, sizeof(*graph));
+}
+
+size_t unreachable_count(const call_graph_t* graph)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < graph->proc_count; i++) {
+        count += !graph->procs[i].reachable;
+    }
+    return count;
+}
+
+bool prune_unreachable(const flat_ast_t* ast, const call_graph_t* graph,
+                       flat_ast_t* pruned)
+{
+    /* numbers are shared by index, so the table is copied whole */
+    pruned->nodes = malloc(ast->count * sizeof(flat_node_t));
+    pruned->nums = malloc((ast->num_count + 1) * sizeof(int64_t));
+    pruned->count = 0;
+    pruned->num_count = ast->num_count;
+    if (!pruned->nodes || !pruned->nums) {
+        free_flat_ast(pruned);
+        return false;
+    }
+    memcpy(pruned->nums, ast->nums, ast->num_count * sizeof(int64_t));
+
+    pruned->nodes[pruned->count++] = ast->nodes[0];
+    size_t proc = 0;
+    FOR_EACH_CHILD(ast, 0, current)
+    {
+        if (flat_label(ast, current) == AST_PROC_DECL &&
+            !graph->procs[proc++].reachable)
+            continue;
+
+        size_t size = ast->nodes[current].size;
+        memcpy(&pruned->nodes[pruned->count], &ast->nodes[current],
+               size * sizeof(flat_node_t));
+        pruned->count += size;
+    }
+    pruned->nodes[0].size = pruned->count;
+    return true;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef CALLGRAPH_H
+#define CALLGRAPH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast.h"
+#include "intern.h"
+
+/* A procedure and the procedures it calls */
+typedef struct {
+    uint32_t name;
+    size_t node;         // its AST_PROC_DECL
+    size_t first_callee; // into call_graph_t.callees
+    size_t callee_count;
+    bool reachable; // called from main, directly or not, or a redeclaration
+    bool recursive; // can call itself, directly or not
+} cg_proc_t;
+
+/*
+ * Procedures in declaration order. Calls are resolved by name, which is exact
+ * since procedures are only declared at the top level. A call to an unknown
+ * name has no edge; the semantic checks report it.
+ */
+typedef struct {
+    cg_proc_t* procs;
+    size_t proc_count;
+    uint32_t* callees; // procedure indices, grouped by caller
+    size_t callee_count;
+} call_graph_t;
+
+bool build_call_graph(const flat_ast_t* ast, const intern_table_t* names,
+                      call_graph_t* graph);
+
+void free_call_graph(call_graph_t* graph);
+
+size_t unreachable_count(const call_graph_t* graph);
+
+/*
+ * Copy ast to pruned without the procedures main can't reach. Returns false
+ * if out of memory.
+ */
+bool prune_unreachable(const flat_ast_t* ast, const call_graph_t* graph,
+                       flat_ast_t* pruned);
+
+#endif
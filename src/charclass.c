@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+/*
+ * Table driven character classification for the lexer. Runs of whitespace,
+ * comment text, identifier characters and digits are skipped 32 (AVX2) or 16
+ * (SSE2) bytes at a time on x86, with the table as the scalar fallback for
+ * other targets and for the tail of the buffer.
+ */
+
+#include "charclass.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+#define S CC_SPACE
+#define D CC_DIGIT
+#define A CC_ALPHA
+#define O CC_OPERATOR
+
+// clang-format off
+const uint8_t char_class[256] = {
+    ['\t'] = S, ['\n'] = S, ['\v'] = S, ['\f'] = S, ['\r'] = S, [' '] = S,
+
+    ['0'] = D, ['1'] = D, ['2'] = D, ['3'] = D, ['4'] = D,
+    ['5'] = D, ['6'] = D, ['7'] = D, ['8'] = D, ['9'] = D,
+
+    ['A'] = A, ['B'] = A, ['C'] = A, ['D'] = A, ['E'] = A, ['F'] = A, ['G'] = A,
+    ['H'] = A, ['I'] = A, ['J'] = A, ['K'] = A, ['L'] = A, ['M'] = A, ['N'] = A,
+    ['O'] = A, ['P'] = A, ['Q'] = A, ['R'] = A, ['S'] = A, ['T'] = A, ['U'] = A,
+    ['V'] = A, ['W'] = A, ['X'] = A, ['Y'] = A, ['Z'] = A,
+    ['a'] = A, ['b'] = A, ['c'] = A, ['d'] = A, ['e'] = A, ['f'] = A, ['g'] = A,
+    ['h'] = A, ['i'] = A, ['j'] = A, ['k'] = A, ['l'] = A, ['m'] = A, ['n'] = A,
+    ['o'] = A, ['p'] = A, ['q'] = A, ['r'] = A, ['s'] = A, ['t'] = A, ['u'] = A,
+    ['v'] = A, ['w'] = A, ['x'] = A, ['y'] = A, ['z'] = A, ['_'] = A,
+
+    ['+'] = O, ['-'] = O, ['*'] = O, ['/'] = O, ['='] = O, ['<'] = O, ['>'] = O,
+    [','] = O, [':'] = O, [';'] = O, ['!'] = O, ['('] = O, [')'] = O,
+
+    ['#'] = CC_COMMENT,
+};
+// clang-format on
+
+#undef S
+#undef D
+#undef A
+#undef O
+
+static const char* space_scalar(const char* p, const char* end)
+{
+    while (p < end && is_class(*p, CC_SPACE))
+        p++;
+    return p;
+}
+
+static const char* digits_scalar(const char* p, const char* end)
+{
+    while (p < end && is_class(*p, CC_DIGIT))
+        p++;
+    return p;
+}
+
+static const char* ident_scalar(const char* p, const char* end)
+{
+    while (p < end && is_class(*p, CC_IDENT))
+        p++;
+    return p;
+}
+
+static const char* comment_scalar(const char* p, const char* end)
+{
+    while (p < end && *p != '\n')
+        p++;
+    return p;
+}
+
+#ifdef HAVE_X86_SIMD
+
+/*
+ * Vector predicates, 0xFF in every lane whose byte belongs to the run.
+ * Range checks use the unsigned min trick:
+ * lo <= c <= hi  <=>  min(c - lo, hi - lo) == c - lo
+ */
+static inline __m128i in_range_128(__m128i v, char lo, char hi)
+{
+    __m128i d = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(hi - lo)), d);
+}
+
+static inline __m128i space_mask_128(__m128i v)
+{
+    return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                        in_range_128(v, '\t', '\r'));
+}
+
+static inline __m128i digits_mask_128(__m128i v)
+{
+    return in_range_128(v, '0', '9');
+}
+
+static inline __m128i ident_mask_128(__m128i v)
+{
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    return _mm_or_si128(_mm_or_si128(in_range_128(lower, 'a', 'z'),
+                                     in_range_128(v, '0', '9')),
+                        _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+}
+
+/* Comment bodies run until '\n', so the mask is "not a newline" */
+static inline __m128i comment_mask_128(__m128i v)
+{
+    return _mm_xor_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                         _mm_set1_epi8(-1));
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i in_range_256(__m256i v, char lo, char hi)
+{
+    __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(hi - lo)), d);
+}
+
+AVX2 static inline __m256i space_mask_256(__m256i v)
+{
+    return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                           in_range_256(v, '\t', '\r'));
+}
+
+AVX2 static inline __m256i digits_mask_256(__m256i v)
+{
+    return in_range_256(v, '0', '9');
+}
+
+AVX2 static inline __m256i ident_mask_256(__m256i v)
+{
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    return _mm256_or_si256(_mm256_or_si256(in_range_256(lower, 'a', 'z'),
+                                           in_range_256(v, '0', '9')),
+                           _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+}
+
+AVX2 static inline __m256i comment_mask_256(__m256i v)
+{
+    return _mm256_xor_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                            _mm256_set1_epi8(-1));
+}
+
+/*
+ * Expand a run skipper for one class. Most runs are shorter than a vector, so
+ * a single SSE2 compare (part of the x86-64 baseline) is tried first; only
+ * runs that fill it move on to the AVX2 loop when the CPU supports it.
+ * Whatever is left after the last full vector goes through the scalar loop.
+ */
+#define DEFINE_SKIP(name)                                                       \
+    AVX2 static const char* name##_avx2(const char* p, const char* end)         \
+    {                                                                           \
+        while (end - p >= 32) {                                                 \
+            __m256i v = _mm256_loadu_si256((const __m256i*)p);                  \
+            uint32_t run = (uint32_t)_mm256_movemask_epi8(name##_mask_256(v));  \
+            if (run != 0xFFFFFFFFu)                                             \
+                return p + __builtin_ctz(~run);                                 \
+            p += 32;                                                            \
+        }                                                                       \
+        return p;                                                               \
+    }                                                                           \
+                                                                                \
+    const char* skip_##name(const char* p, const char* end)                     \
+    {                                                                           \
+        bool first = true;                                                      \
+        while (end - p >= 16) {                                                 \
+            __m128i v = _mm_loadu_si128((const __m128i*)p);                     \
+            uint32_t run = (uint32_t)_mm_movemask_epi8(name##_mask_128(v));     \
+            if (run != 0xFFFFu)                                                 \
+                return p + __builtin_ctz(~run);                                 \
+            p += 16;                                                            \
+            if (first && __builtin_cpu_supports("avx2")) {                      \
+                p = name##_avx2(p, end);                                        \
+            }                                                                   \
+            first = false;                                                      \
+        }                                                                       \
+        return name##_scalar(p, end);                                           \
+    }
+
+#else
+
+#define DEFINE_SKIP(name)                                                       \
+    const char* skip_##name(const char* p, const char* end)                     \
+    {                                                                           \
+        return name##_scalar(p, end);                                           \
+    }
+
+#endif
+
+DEFINE_SKIP(space)
+DEFINE_SKIP(digits)
+DEFINE_SKIP(ident)
+DEFINE_SKIP(comment)
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef CHARCLASS_H
+#define CHARCLASS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Character classes used by the lexer, one bit each */
+enum {
+    CC_SPACE = 1 << 0,
+    CC_DIGIT = 1 << 1,
+    CC_ALPHA = 1 << 2, // letters and '_'
+    CC_OPERATOR = 1 << 3,
+    CC_COMMENT = 1 << 4,
+
+    CC_IDENT = CC_ALPHA | CC_DIGIT,
+    CC_VALID = CC_SPACE | CC_DIGIT | CC_ALPHA | CC_OPERATOR | CC_COMMENT
+};
+
+extern const uint8_t char_class[256];
+
+static inline bool is_class(char c, uint8_t cls)
+{
+    return char_class[(unsigned char)c] & cls;
+}
+
+/*
+ * Each of these returns a pointer to the first character in [p, end) that
+ * does not belong to the run, or end.
+ */
+const char* skip_space(const char* p, const char* end);
+
+const char* skip_comment(const char* p, const char* end);
+
+const char* skip_ident(const char* p, const char* end);
+
+const char* skip_digits(const char* p, const char* end);
+
+#endif
@@ -12,231 +12,316 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ast.h"
 #include "codegen.h"
+#include "ssa.h"
 #include "symtab.h"
 
-const int MAX = 1000;
-static int index = 0;
-static symbol_t* scope_array[MAX];
+/*
+ * State of one code generation run. Types and blocks are created in the
+ * module's own LLVM context, never the global one, so modules of different
+ * contexts can be generated on different threads at the same time.
+ *
+ * Blocks are tracked through the SSA builder in both modes, since it records
+ * the predecessors of each block anyway. With ssa set, procedure locals are
+ * SSA variables numbered by their symbol's index; otherwise each gets an
+ * alloca and the builder only ever sees zero variables.
+ */
+typedef struct {
+    const flat_ast_t* ast;
+    symtab_t* table;
+    LLVMContextRef context;
+    LLVMModuleRef module;
+    LLVMBuilderRef ir_builder;
+    LLVMTypeRef i64;
+    codegen_options_t options;
+    size_t proc; // index in options.calls of the next procedure
+    ssa_builder_t ssa_builder;
+    ssa_block_t* block; // where the builder is positioned
+} codegen_t;
+
+static const char* name_of(codegen_t* cg, size_t node)
+{
+    return interned_string(cg->table->names, flat_ident(cg->ast, node));
+}
 
-static void cleanup_scopes()
+static void add_attribute(codegen_t* cg, LLVMValueRef function, const char* name)
 {
-    symbol_t* tmp = NULL;
-    symbol_t* current = NULL;
-    for (int i = 0; i < index; i++) {
-        if (scope_array[i]) {
-            current = scope_array[i];
-            while (current) {
-                tmp = current;
-                current = current->next;
-                free(tmp);
-            }
-        }
-    }
+    unsigned kind = LLVMGetEnumAttributeKindForName(name, strlen(name));
+    LLVMAddAttributeAtIndex(function, LLVMAttributeFunctionIndex,
+                            LLVMCreateEnumAttribute(cg->context, kind, 0));
+}
+
+static ssa_block_t* new_block(codegen_t* cg, LLVMValueRef function, const char* name)
+{
+    return ssa_new_block(&cg->ssa_builder,
+                         LLVMAppendBasicBlockInContext(cg->context, function, name));
+}
+
+static void position_at(codegen_t* cg, ssa_block_t* block)
+{
+    LLVMPositionBuilderAtEnd(cg->ir_builder, block->block);
+    cg->block = block;
+}
+
+static void branch(codegen_t* cg, ssa_block_t* to)
+{
+    LLVMBuildBr(cg->ir_builder, to->block);
+    ssa_add_pred(&cg->ssa_builder, to, cg->block);
+}
+
+static void cond_branch(codegen_t* cg, LLVMValueRef condition, ssa_block_t* then_to,
+                        ssa_block_t* else_to)
+{
+    LLVMBuildCondBr(cg->ir_builder, condition, then_to->block, else_to->block);
+    ssa_add_pred(&cg->ssa_builder, then_to, cg->block);
+    ssa_add_pred(&cg->ssa_builder, else_to, cg->block);
+}
+
+/* Locals are SSA variables in SSA mode, everything else lives in memory */
+static bool in_ssa(codegen_t* cg, const symbol_t* sym)
+{
+    return cg->options.ssa && sym->level > 0 && sym->type != SYM_PROCEDURE;
+}
+
+static LLVMValueRef read_variable(codegen_t* cg, uint32_t name)
+{
+    symbol_t* sym = lookup(cg->table, name);
+    if (in_ssa(cg, sym))
+        return ssa_read(&cg->ssa_builder, cg->block, sym->index);
+
+    /* Load from memory location based on previous alloca/store instruction */
+    return LLVMBuildLoad(cg->ir_builder, sym->value, "");
+}
+
+static void write_variable(codegen_t* cg, uint32_t name, LLVMValueRef value)
+{
+    symbol_t* sym = lookup(cg->table, name);
+    if (in_ssa(cg, sym))
+        ssa_write(cg->block, sym->index, value);
+    else
+        LLVMBuildStore(cg->ir_builder, value, sym->value);
 }
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wswitch"
 #pragma clang diagnostic ignored "-Wreturn-type"
 
-static LLVMValueRef number_value(ast_node_t* node)
+static LLVMValueRef number_value(codegen_t* cg, size_t node)
 {
-    return LLVMConstInt(LLVMInt64Type(), node->num_value, true);
+    return LLVMConstInt(cg->i64, flat_num(cg->ast, node), true);
 }
 
-static LLVMValueRef expression(ast_node_t* node, LLVMBuilderRef ir_builder)
+static LLVMValueRef expression(codegen_t* cg, size_t node)
 {
-    ast_node_t* lhs_node = NULL;
-    ast_node_t* rhs_node = NULL;
-
-    LLVMValueRef variable_location_on_stack = NULL;
+    const flat_ast_t* ast = cg->ast;
+    LLVMBuilderRef ir_builder = cg->ir_builder;
+    size_t lhs_node = 0;
+    size_t rhs_node = 0;
+
+    /* operands of binary operators */
+    if (ast->nodes[node].size > 1) {
+        lhs_node = flat_first_child(node);
+        rhs_node = flat_next_sibling(ast, lhs_node);
+    }
 
-    switch (node->label) {
+    switch (flat_label(ast, node)) {
         case AST_ADD:
-            lhs_node = node->first_child;
-            rhs_node = lhs_node->next_sibling;
-            return LLVMBuildAdd(ir_builder, expression(lhs_node, ir_builder),
-                                expression(rhs_node, ir_builder), "");
+            return (cg->options.strict_overflow ? LLVMBuildNSWAdd : LLVMBuildAdd)(
+                ir_builder, expression(cg, lhs_node), expression(cg, rhs_node), "");
 
         case AST_SUB:
-            lhs_node = node->first_child;
-            rhs_node = lhs_node->next_sibling;
-            return LLVMBuildSub(ir_builder, expression(lhs_node, ir_builder),
-                                expression(rhs_node, ir_builder), "");
+            return (cg->options.strict_overflow ? LLVMBuildNSWSub : LLVMBuildSub)(
+                ir_builder, expression(cg, lhs_node), expression(cg, rhs_node), "");
 
         case AST_MUL:
-            lhs_node = node->first_child;
-            rhs_node = lhs_node->next_sibling;
-            return LLVMBuildMul(ir_builder, expression(lhs_node, ir_builder),
-                                expression(rhs_node, ir_builder), "");
+            return (cg->options.strict_overflow ? LLVMBuildNSWMul : LLVMBuildMul)(
+                ir_builder, expression(cg, lhs_node), expression(cg, rhs_node), "");
 
         case AST_DIV:
-            lhs_node = node->first_child;
-            rhs_node = lhs_node->next_sibling;
-            return LLVMBuildSDiv(ir_builder, expression(lhs_node, ir_builder),
-                                 expression(rhs_node, ir_builder), "");
+            return LLVMBuildSDiv(ir_builder, expression(cg, lhs_node),
+                                 expression(cg, rhs_node), "");
 
         case AST_NUM:
-            return number_value(node);
+            return number_value(cg, node);
 
         case AST_IDENT:
-            /* Load from memory location based on previous alloca/store
-             * instruction */
-            variable_location_on_stack = lookup(node->ident_name)->value;
-            return LLVMBuildLoad(ir_builder, variable_location_on_stack, "");
+            return read_variable(cg, flat_ident(ast, node));
     }
 }
 
-static void assignment(ast_node_t* node, LLVMBuilderRef ir_builder)
+static void assignment(codegen_t* cg, size_t node)
 {
-    /* After evaluating the expression, store the answer's value in symbol
-     * table. This same location is used by load instructions when the
-     * identifier comes up in an expression.
+    /* After evaluating the expression, store the answer's value in the
+     * variable's location, or make it the variable's current SSA value.
      */
-    ast_node_t* lhs_node = node->first_child;
-    ast_node_t* rhs_node = lhs_node->next_sibling;
+    size_t lhs_node = flat_first_child(node);
+    size_t rhs_node = flat_next_sibling(cg->ast, lhs_node);
 
-    LLVMValueRef variable_location_on_stack = lookup(lhs_node->ident_name)->value;
-    LLVMBuildStore(ir_builder, expression(rhs_node, ir_builder),
-                   variable_location_on_stack);
+    write_variable(cg, flat_ident(cg->ast, lhs_node), expression(cg, rhs_node));
 }
 
-static void generate_globals(ast_node_t* current, symbol_t** symbol_table,
-                             size_t* current_level, LLVMModuleRef module,
-                             LLVMBuilderRef ir_builder)
+static bool defines_main(const codegen_t* cg)
 {
-    if (current->label == AST_CONST_DECL) {
-        ast_node_t* c_ident = current->first_child;
-        while (c_ident) {
+    return cg->options.unit == CODEGEN_PROGRAM || cg->options.unit == CODEGEN_MAIN;
+}
+
+static void generate_globals(codegen_t* cg, size_t current)
+{
+    const flat_ast_t* ast = cg->ast;
+
+    /* fold_constants drops CONSTs; any left are kept by main's unit only */
+    if (flat_label(ast, current) == AST_CONST_DECL && defines_main(cg)) {
+        FOR_EACH_CHILD(ast, current, c_ident)
+        {
             LLVMValueRef global_c =
-                LLVMAddGlobal(module, LLVMInt64Type(), c_ident->ident_name);
-            LLVMValueRef global_c_val = number_value(c_ident->first_child);
+                LLVMAddGlobal(cg->module, cg->i64, name_of(cg, c_ident));
+            LLVMValueRef global_c_val = number_value(cg, flat_first_child(c_ident));
 
             LLVMSetInitializer(global_c, global_c_val);
+            LLVMSetGlobalConstant(global_c, true);
+            LLVMSetLinkage(global_c, LLVMInternalLinkage);
 
-            symbol_t* new_symtab_entry =
-                new_symbol(c_ident->ident_name, SYM_CONST,
-                           LLVMGetNamedGlobal(module, c_ident->ident_name),
-                           *current_level);
-
-            insert_sym(symbol_table, new_symtab_entry);
-            c_ident = c_ident->next_sibling;
+            insert_sym(cg->table, flat_ident(ast, c_ident), SYM_CONST, global_c);
         }
     }
 
-    else if (current->label == AST_VAR_DECL) {
-        ast_node_t* c_ident = current->first_child;
-        ast_node_t* dummy_node = calloc(1, sizeof(ast_node_t));
-
-        while (c_ident) {
+    else if (flat_label(ast, current) == AST_VAR_DECL) {
+        FOR_EACH_CHILD(ast, current, c_ident)
+        {
             LLVMValueRef global_v =
-                LLVMAddGlobal(module, LLVMInt64Type(), c_ident->ident_name);
-            LLVMValueRef global_v_val = number_value(dummy_node);
-            LLVMSetInitializer(global_v, global_v_val);
-
-            symbol_t* new_symtab_entry =
-                new_symbol(c_ident->ident_name, SYM_CONST,
-                           LLVMGetNamedGlobal(module, c_ident->ident_name),
-                           *current_level);
-            insert_sym(symbol_table, new_symtab_entry);
-            c_ident = c_ident->next_sibling;
+                LLVMAddGlobal(cg->module, cg->i64, name_of(cg, c_ident));
+            LLVMValueRef global_v_val = LLVMConstInt(cg->i64, 0, true);
+            if (defines_main(cg))
+                LLVMSetInitializer(global_v, global_v_val);
+            if (cg->options.whole_program)
+                LLVMSetLinkage(global_v, LLVMInternalLinkage);
+
+            insert_sym(cg->table, flat_ident(ast, c_ident), SYM_VAR, global_v);
         }
-        free(dummy_node);
     }
 }
 
-static void generate_locals(ast_node_t* current, symbol_t** symbol_table,
-                            size_t* current_level, LLVMModuleRef module,
-                            LLVMBuilderRef ir_builder)
+static void generate_locals(codegen_t* cg, size_t current)
 {
-    if (current->label == AST_CONST_DECL) {
-        ast_node_t* c_ident = current->first_child;
-        while (c_ident) {
-            LLVMValueRef local_c =
-                LLVMBuildAlloca(ir_builder, LLVMInt64Type(), c_ident->ident_name);
-            LLVMBuildStore(ir_builder, number_value(c_ident->first_child), local_c);
-            symbol_t* new_symtab_entry =
-                new_symbol(c_ident->ident_name, SYM_CONST, local_c, *current_level);
-
-            insert_sym(symbol_table, new_symtab_entry);
-            c_ident = c_ident->next_sibling;
+    const flat_ast_t* ast = cg->ast;
+
+    if (cg->options.ssa) {
+        /* CONSTs are written once here, VARs start out as 0 */
+        FOR_EACH_CHILD(ast, current, c_ident)
+        {
+            sym_type_t type =
+                flat_label(ast, current) == AST_CONST_DECL ? SYM_CONST : SYM_VAR;
+            LLVMValueRef value = type == SYM_CONST
+                                     ? number_value(cg, flat_first_child(c_ident))
+                                     : LLVMConstInt(cg->i64, 0, true);
+            symbol_t* sym =
+                insert_sym(cg->table, flat_ident(ast, c_ident), type, NULL);
+            ssa_write(cg->block, sym->index, value);
         }
     }
 
-    else if (current->label == AST_VAR_DECL) {
-        ast_node_t* c_ident = current->first_child;
-        ast_node_t* dummy_node = calloc(1, sizeof(ast_node_t));
+    else if (flat_label(ast, current) == AST_CONST_DECL) {
+        FOR_EACH_CHILD(ast, current, c_ident)
+        {
+            LLVMValueRef local_c =
+                LLVMBuildAlloca(cg->ir_builder, cg->i64, name_of(cg, c_ident));
+            LLVMBuildStore(cg->ir_builder,
+                           number_value(cg, flat_first_child(c_ident)), local_c);
+            insert_sym(cg->table, flat_ident(ast, c_ident), SYM_CONST, local_c);
+        }
+    }
 
-        while (c_ident) {
+    else if (flat_label(ast, current) == AST_VAR_DECL) {
+        FOR_EACH_CHILD(ast, current, c_ident)
+        {
             LLVMValueRef local_v =
-                LLVMBuildAlloca(ir_builder, LLVMInt64Type(), c_ident->ident_name);
-            LLVMBuildStore(ir_builder, number_value(dummy_node), local_v);
-            symbol_t* new_symtab_entry =
-                new_symbol(c_ident->ident_name, SYM_CONST, local_v, *current_level);
+                LLVMBuildAlloca(cg->ir_builder, cg->i64, name_of(cg, c_ident));
+            LLVMBuildStore(cg->ir_builder, LLVMConstInt(cg->i64, 0, true),
+                           local_v);
+            insert_sym(cg->table, flat_ident(ast, c_ident), SYM_VAR, local_v);
+        }
+    }
+}
+
+static void generate_statement(codegen_t* cg, size_t node,
+                               LLVMValueRef function_ref);
 
-            insert_sym(symbol_table, new_symtab_entry);
-            c_ident = c_ident->next_sibling;
+/* Generate a statement block's statements, or the single statement it stands for */
+static void generate_statement_block(codegen_t* cg, size_t node,
+                                     LLVMValueRef function_ref)
+{
+    if (flat_label(cg->ast, node) == AST_STMT_BLOCK) {
+        FOR_EACH_CHILD(cg->ast, node, statement)
+        {
+            generate_statement(cg, statement, function_ref);
         }
-        free(dummy_node);
+    } else {
+        generate_statement(cg, node, function_ref);
     }
 }
 
-static void generate_statement(ast_node_t* node, symbol_t** symbol_table,
-                               LLVMModuleRef module, LLVMBuilderRef ir_builder,
-                               LLVMValueRef function_ref)
+static void generate_statement(codegen_t* cg, size_t node, LLVMValueRef function_ref)
 {
-    if (node->label == AST_ASSIGN) {
-        assignment(node, ir_builder);
+    const flat_ast_t* ast = cg->ast;
+    LLVMBuilderRef ir_builder = cg->ir_builder;
+    ast_label_t label = flat_label(ast, node);
+
+    if (label == AST_ASSIGN) {
+        assignment(cg, node);
     }
 
-    else if (node->label == AST_CALL) {
-        symbol_t* function_sym = lookup(node->first_child->ident_name);
+    else if (label == AST_CALL) {
+        symbol_t* function_sym =
+            lookup(cg->table, flat_ident(ast, flat_first_child(node)));
         assert(function_sym);
-        LLVMBuildCall(ir_builder, function_sym->value, NULL, 0, "");
+        LLVMValueRef call =
+            LLVMBuildCall(ir_builder, function_sym->value, NULL, 0, "");
+        if (cg->options.whole_program)
+            LLVMSetInstructionCallConv(call, LLVMFastCallConv);
     }
 
-    else if (node->label == AST_PRINT) {
-        LLVMValueRef print64 = LLVMGetNamedFunction(module, "print64");
+    else if (label == AST_PRINT) {
+        LLVMValueRef print64 = LLVMGetNamedFunction(cg->module, "print64");
 
-        ast_label_t label = node->first_child->label;
+        size_t operand = flat_first_child(node);
         LLVMValueRef num = NULL;
-        if (label == AST_NUM) {
-            num = number_value(node->first_child);
+        if (flat_label(ast, operand) == AST_NUM) {
+            num = number_value(cg, operand);
         }
 
-        else if (label == AST_IDENT) {
-            LLVMValueRef variable_location_on_stack =
-                lookup(node->first_child->ident_name)->value;
-            num = LLVMBuildLoad(ir_builder, variable_location_on_stack, "");
+        else if (flat_label(ast, operand) == AST_IDENT) {
+            num = read_variable(cg, flat_ident(ast, operand));
         }
         LLVMBuildCall(ir_builder, print64, &num, 1, "");
     }
 
-    else if (node->label == AST_SCAN) {
-        LLVMValueRef scan64 = LLVMGetNamedFunction(module, "scan64");
+    else if (label == AST_SCAN) {
+        LLVMValueRef scan64 = LLVMGetNamedFunction(cg->module, "scan64");
         LLVMValueRef num = LLVMBuildCall(ir_builder, scan64, NULL, 0, "");
-        LLVMValueRef variable_location_on_stack =
-            lookup(node->first_child->ident_name)->value;
-        LLVMBuildStore(ir_builder, num, variable_location_on_stack);
+        write_variable(cg, flat_ident(ast, flat_first_child(node)), num);
     }
 
-    else if (node->label == AST_WHILE || node->label == AST_IF) {
+    else if (label == AST_WHILE || label == AST_IF) {
         LLVMIntPredicate cmp;
-        LLVMBasicBlockRef condition_block =
-            LLVMAppendBasicBlock(function_ref, "condition_block");
-        LLVMBasicBlockRef then_block =
-            LLVMAppendBasicBlock(function_ref, "then_block");
-        LLVMBasicBlockRef else_block =
-            LLVMAppendBasicBlock(function_ref, "else_block");
-        LLVMBasicBlockRef end_block =
-            LLVMAppendBasicBlock(function_ref, "end_block");
-        LLVMBuildBr(ir_builder, condition_block);
-        LLVMPositionBuilderAtEnd(ir_builder, condition_block);
-
-        ast_node_t* child = node->first_child;
-        switch (child->label) {
+        ssa_block_t* condition_block =
+            new_block(cg, function_ref, "condition_block");
+        ssa_block_t* then_block = new_block(cg, function_ref, "then_block");
+        ssa_block_t* else_block = new_block(cg, function_ref, "else_block");
+        ssa_block_t* end_block = new_block(cg, function_ref, "end_block");
+        branch(cg, condition_block);
+
+        /* a loop's condition is also reached from the end of its body */
+        if (label == AST_IF) {
+            ssa_seal_block(&cg->ssa_builder, condition_block);
+        }
+        position_at(cg, condition_block);
+
+        size_t child = flat_first_child(node);
+        ast_label_t condition_label = flat_label(ast, child);
+        switch (condition_label) {
             case AST_GTE:
                 cmp = LLVMIntSGE;
                 break;
@@ -259,126 +344,150 @@ static void generate_statement(ast_node_t* node, symbol_t** symbol_table,
                 cmp = LLVMIntNE;
                 break;
         }
-        LLVMValueRef lhs = expression(child->first_child, ir_builder);
+        size_t lhs_node = flat_first_child(child);
+        LLVMValueRef lhs = expression(cg, lhs_node);
         LLVMValueRef rhs = NULL;
 
-        if (child->label == AST_ODD) {
+        if (condition_label == AST_ODD) {
             // handle ODD keyword separately -> expression % 2 != 0
-            lhs = LLVMBuildSRem(ir_builder, lhs,
-                                LLVMConstInt(LLVMInt64Type(), 2, true), "");
-            rhs = LLVMConstInt(LLVMInt64Type(), 0, true);
+            lhs = LLVMBuildSRem(ir_builder, lhs, LLVMConstInt(cg->i64, 2, true), "");
+            rhs = LLVMConstInt(cg->i64, 0, true);
         }
 
         else {
-            rhs = expression(child->first_child->next_sibling, ir_builder);
+            rhs = expression(cg, flat_next_sibling(ast, lhs_node));
         }
 
         LLVMValueRef condition =
             LLVMBuildICmp(ir_builder, cmp, lhs, rhs, "condition");
 
-        LLVMBuildCondBr(ir_builder, condition, then_block, else_block);
-        LLVMPositionBuilderAtEnd(ir_builder, then_block);
+        cond_branch(cg, condition, then_block, else_block);
+        ssa_seal_block(&cg->ssa_builder, then_block);
+        ssa_seal_block(&cg->ssa_builder, else_block);
+        position_at(cg, then_block);
+
+        child = flat_next_sibling(ast, child);
+        generate_statement_block(cg, child, function_ref);
 
-        child = child->next_sibling;
-        if (child->label == AST_STMT_BLOCK) {
-            ast_node_t* statement = child->first_child;
-            while (statement) {
-                generate_statement(statement, symbol_table, module, ir_builder,
-                                   function_ref);
-                statement = statement->next_sibling;
-            }
-        } else {
-            generate_statement(child, symbol_table, module, ir_builder,
-                               function_ref);
-        }
         /* last part, jump to condition again if it is a while loop */
-        if (node->label == AST_WHILE) {
-            LLVMBuildBr(ir_builder, condition_block);
+        if (label == AST_WHILE) {
+            branch(cg, condition_block);
+            ssa_seal_block(&cg->ssa_builder, condition_block);
         } else {
-            LLVMBuildBr(ir_builder, end_block);
+            branch(cg, end_block);
         }
 
-        LLVMPositionBuilderAtEnd(ir_builder, else_block);
+        position_at(cg, else_block);
         /* Code for the else block. When no else block exists or in case of a while
          * loop, simply branch to end_block */
-        child = child->next_sibling;
-        if (child && child->label == AST_STMT_BLOCK) {
-            ast_node_t* statement = child->first_child;
-            while (statement) {
-                generate_statement(statement, symbol_table, module, ir_builder,
-                                   function_ref);
-                statement = statement->next_sibling;
-            }
-        } else if (child) {
-            generate_statement(child, symbol_table, module, ir_builder,
-                               function_ref);
+        child = flat_next_sibling(ast, child);
+        if (child < flat_end(ast, node)) {
+            generate_statement_block(cg, child, function_ref);
         }
-        LLVMBuildBr(ir_builder, end_block);
-        LLVMPositionBuilderAtEnd(ir_builder, end_block);
+        branch(cg, end_block);
+        ssa_seal_block(&cg->ssa_builder, end_block);
+        position_at(cg, end_block);
     }
 }
 
-static void generate_function(ast_node_t* node, symbol_t** symbol_table,
-                              size_t* current_level, LLVMModuleRef module,
-                              LLVMBuilderRef ir_builder)
+/* Add the procedure at node to the module and the symbol table, without a body */
+static LLVMValueRef declare_function(codegen_t* cg, size_t node)
 {
-    ast_node_t* function_head = node->first_child;
-    ast_node_t* function_body = function_head->next_sibling; // AST_BLOCK
+    size_t function_head = flat_first_child(node);
 
     LLVMTypeRef* param_type_list = NULL;
-    LLVMTypeRef function_type =
-        LLVMFunctionType(LLVMVoidType(), param_type_list, 0, false);
+    LLVMTypeRef function_type = LLVMFunctionType(
+        LLVMVoidTypeInContext(cg->context), param_type_list, 0, false);
     LLVMValueRef function =
-        LLVMAddFunction(module, function_head->ident_name, function_type);
-
-    LLVMBasicBlockRef entry = LLVMAppendBasicBlock(function, "entry");
-    LLVMPositionBuilderAtEnd(ir_builder, entry);
-
-    /* Add this function's details to symbol table */
-    (*current_level)--;
-    symbol_t* new_symtab_entry = new_symbol(function_head->ident_name, SYM_PROCEDURE,
-                                            function, *current_level);
-    insert_sym(symbol_table, new_symtab_entry);
-    (*current_level)++;
-
-    ast_node_t* current = function_body->first_child;
-    ast_node_t* statement = NULL;
-    while (current) {
-        if (current->label == AST_CONST_DECL || current->label == AST_VAR_DECL) {
-            generate_locals(current, symbol_table, current_level, module,
-                            ir_builder);
-        } else if (current->label == AST_STMT_BLOCK) {
-            statement = current->first_child;
-            while (statement) {
-                generate_statement(statement, symbol_table, module, ir_builder,
-                                   function);
-                statement = statement->next_sibling;
+        LLVMAddFunction(cg->module, name_of(cg, function_head), function_type);
+
+    /* calls are matched in generate_statement() */
+    if (cg->options.whole_program) {
+        LLVMSetLinkage(function, LLVMInternalLinkage);
+        LLVMSetFunctionCallConv(function, LLVMFastCallConv);
+    }
+    const cg_proc_t* proc = &cg->options.calls->procs[cg->proc++];
+    assert(proc->node == node);
+    add_attribute(cg, function, "nounwind");
+    if (!proc->recursive)
+        add_attribute(cg, function, "norecurse");
+
+    insert_sym(cg->table, flat_ident(cg->ast, function_head), SYM_PROCEDURE,
+               function);
+    return function;
+}
+
+static void generate_function(codegen_t* cg, size_t node)
+{
+    const flat_ast_t* ast = cg->ast;
+    size_t function_head = flat_first_child(node);
+    size_t function_body = flat_next_sibling(ast, function_head); // AST_BLOCK
+    LLVMValueRef function = declare_function(cg, node);
+
+    /* every CONST and VAR of the procedure is a variable in SSA mode */
+    size_t local_count = 0;
+    FOR_EACH_CHILD(ast, function_body, current)
+    {
+        ast_label_t label = flat_label(ast, current);
+        if (cg->options.ssa && (label == AST_CONST_DECL || label == AST_VAR_DECL)) {
+            FOR_EACH_CHILD(ast, current, c_ident)
+            {
+                local_count++;
             }
-        } else if (current) { // single statement
-            generate_statement(current, symbol_table, module, ir_builder, function);
         }
-        current = current->next_sibling;
     }
-    LLVMBuildRetVoid(ir_builder);
+    ssa_begin_function(&cg->ssa_builder, local_count);
+
+    ssa_block_t* entry = new_block(cg, function, "entry");
+    ssa_seal_block(&cg->ssa_builder, entry);
+    position_at(cg, entry);
+
+    push_scope(cg->table);
+
+    FOR_EACH_CHILD(ast, function_body, current)
+    {
+        ast_label_t label = flat_label(ast, current);
+        if (label == AST_CONST_DECL || label == AST_VAR_DECL) {
+            generate_locals(cg, current);
+        } else { // statement block or single statement
+            generate_statement_block(cg, current, function);
+        }
+    }
+    LLVMBuildRetVoid(cg->ir_builder);
+    ssa_end_function(&cg->ssa_builder);
+    pop_scope(cg->table);
 }
 
-static bool stmt_starts(ast_node_t* node)
+static bool stmt_starts(ast_label_t label)
 {
-    ast_label_t label = node->label;
     return label == AST_IF || label == AST_ASSIGN || label == AST_CALL ||
            label == AST_WHILE || label == AST_PRINT || label == AST_SCAN;
 }
 
-void generate_code(ast_node_t* root, symbol_t** symbol_table, size_t* current_level,
-                   LLVMModuleRef module, LLVMBuilderRef ir_builder)
+void generate_code(const flat_ast_t* ast, symtab_t* table, LLVMModuleRef module,
+                   LLVMBuilderRef ir_builder, const codegen_options_t* options)
 {
-    LLVMTypeRef print64_param_type_list[] = { LLVMInt64Type() };
+    codegen_t cg;
+    cg.ast = ast;
+    cg.table = table;
+    cg.context = LLVMGetModuleContext(module);
+    cg.module = module;
+    cg.ir_builder = ir_builder;
+    cg.i64 = LLVMInt64TypeInContext(cg.context);
+    cg.options = *options;
+    cg.proc = 0;
+    init_ssa(&cg.ssa_builder, cg.context, cg.i64);
+    cg.block = NULL;
+
+    LLVMTypeRef void_type = LLVMVoidTypeInContext(cg.context);
+
+    LLVMTypeRef print64_param_type_list[] = { cg.i64 };
     LLVMTypeRef print64_type =
-        LLVMFunctionType(LLVMVoidType(), print64_param_type_list, 1, false);
+        LLVMFunctionType(void_type, print64_param_type_list, 1, false);
 
     LLVMTypeRef* scan64_param_type_list = NULL;
     LLVMTypeRef scan64_type =
-        LLVMFunctionType(LLVMInt64Type(), scan64_param_type_list, 0, false);
+        LLVMFunctionType(cg.i64, scan64_param_type_list, 0, false);
 
 /* Ignore unused variable warnings here */
 #pragma clang diagnostic push
@@ -387,55 +496,64 @@ void generate_code(ast_node_t* root, symbol_t** symbol_table, size_t* current_le
     LLVMValueRef scan64 = LLVMAddFunction(module, "scan64", scan64_type);
 #pragma clang diagnostic pop
 
-    if (root->label == AST_ROOT) {
-        ast_node_t* current = root->first_child;
-        while (current) {
-            if (current->label == AST_CONST_DECL || current->label == AST_VAR_DECL) {
-                generate_globals(current, symbol_table, current_level, module,
-                                 ir_builder);
+    size_t root = 0;
+    if (flat_label(ast, root) == AST_ROOT) {
+        push_scope(table); // globals
+        FOR_EACH_CHILD(ast, root, current)
+        {
+            ast_label_t label = flat_label(ast, current);
+            if (label == AST_CONST_DECL || label == AST_VAR_DECL) {
+                generate_globals(&cg, current);
             }
 
-            else if (current->label == AST_PROC_DECL) {
-                (*current_level)++;
-                generate_function(current, symbol_table, current_level, module,
-                                  ir_builder);
-                save_scope(&scope_array[index], current_level);
-                index++;
-                (*current_level)--;
+            else if (label == AST_PROC_DECL) {
+                if (options->unit == CODEGEN_PROGRAM || options->unit == current) {
+                    double start = options->trace ? trace_clock() : 0;
+                    generate_function(&cg, current);
+                    if (options->trace)
+                        trace_event(options->trace, "generate_function",
+                                    name_of(&cg, flat_first_child(current)), start,
+                                    trace_clock());
+                } else {
+                    declare_function(&cg, current);
+                }
             }
 
-            else if (current->label == AST_STMT_BLOCK || stmt_starts(current)) {
+            else if ((label == AST_STMT_BLOCK || stmt_starts(label)) &&
+                     defines_main(&cg)) {
                 /* Generate IR for main function here */
+                double start = options->trace ? trace_clock() : 0;
 
                 LLVMTypeRef* param_type_list = NULL;
 
                 /* function signature corresponding to int main() which
                  * returns 0 at the end */
+                LLVMTypeRef i32 = LLVMInt32TypeInContext(cg.context);
                 LLVMTypeRef main_function_type =
-                    LLVMFunctionType(LLVMInt32Type(), param_type_list, 0, false);
+                    LLVMFunctionType(i32, param_type_list, 0, false);
                 LLVMValueRef main =
                     LLVMAddFunction(module, "main", main_function_type);
+                add_attribute(&cg, main, "nounwind");
+                add_attribute(&cg, main, "norecurse");
 
-                LLVMBasicBlockRef entry = LLVMAppendBasicBlock(main, "entry");
-                LLVMPositionBuilderAtEnd(ir_builder, entry);
+                ssa_begin_function(&cg.ssa_builder, 0);
+                ssa_block_t* entry = new_block(&cg, main, "entry");
+                ssa_seal_block(&cg.ssa_builder, entry);
+                position_at(&cg, entry);
+
+                generate_statement_block(&cg, current, main);
 
-                ast_node_t* statement = current->label == AST_STMT_BLOCK
-                                            ? current->first_child
-                                            : current;
-                while (statement) {
-                    generate_statement(statement, symbol_table, module, ir_builder,
-                                       main);
-                    statement = statement->next_sibling;
-                }
                 /* finally main() returns 0 */
-                LLVMBuildRet(ir_builder, LLVMConstInt(LLVMInt32Type(), 0, true));
+                LLVMBuildRet(ir_builder, LLVMConstInt(i32, 0, true));
+                ssa_end_function(&cg.ssa_builder);
+                if (options->trace)
+                    trace_event(options->trace, "generate_function", "main", start,
+                                trace_clock());
             }
-            current = current->next_sibling;
         }
-        save_scope(&scope_array[index], current_level);
-        index++;
-        cleanup_scopes();
+        pop_scope(table);
     }
+    free_ssa(&cg.ssa_builder);
 }
 
-#pragma clang diagnostic pop
\ No newline at end of file
+#pragma clang diagnostic pop
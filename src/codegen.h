@@ -7,12 +7,39 @@
 #ifndef CODEGEN_H
 #define CODEGEN_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include <llvm-c/Core.h>
 
 #include "ast.h"
+#include "callgraph.h"
 #include "symtab.h"
+#include "trace.h"
+
+typedef struct {
+    /* procedure locals become SSA values with phis at the joins of IF and
+     * WHILE, instead of stack slots accessed with loads and stores */
+    bool ssa;
+    /* nothing outside the module uses anything but main: other symbols are
+     * internal and procedures use the fast calling convention */
+    bool whole_program;
+    /* signed overflow is undefined, so arithmetic is nsw */
+    bool strict_overflow;
+    const call_graph_t* calls; // of the AST being generated, for norecurse
+    /*
+     * What to generate: CODEGEN_PROGRAM for everything, CODEGEN_MAIN for the
+     * globals and main with procedures only declared, or the node of one
+     * procedure, with the global VARs and other procedures only declared
+     */
+    size_t unit;
+    trace_t* trace; // where each function generated is timed, or NULL
+} codegen_options_t;
+
+#define CODEGEN_PROGRAM SIZE_MAX
+#define CODEGEN_MAIN 0 // the root
 
-void generate_code(ast_node_t* root, symbol_t** symbol_table, size_t* current_level,
-                   LLVMModuleRef module, LLVMBuilderRef ir_builder);
+void generate_code(const flat_ast_t* ast, symtab_t* table, LLVMModuleRef module,
+                   LLVMBuilderRef ir_builder, const codegen_options_t* options);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "diag.h"
+
+void init_diagnostics(diag_list_t* list)
+{
+    memset(list, 0, sizeof(*list));
+}
+
+/* Messages that cannot be stored for lack of memory are dropped */
+void report(diag_list_t* list, const char* format, ...)
+{
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 16;
+        char** messages = realloc(list->messages, capacity * sizeof(char*));
+        if (!messages)
+            return;
+        list->messages = messages;
+        list->capacity = capacity;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (len < 0)
+        return;
+
+    char* message = malloc(len + 1);
+    if (!message)
+        return;
+    va_start(args, format);
+    vsnprintf(message, len + 1, format, args);
+    va_end(args);
+
+    list->messages[list->count++] = message;
+}
+
+void clear_diagnostics(diag_list_t* list)
+{
+    for (size_t i = 0; i < list->count; i++) {
+        free(list->messages[i]);
+    }
+    list->count = 0;
+}
+
+void free_diagnostics(diag_list_t* list)
+{
+    clear_diagnostics(list);
+    free(list->messages);
+    init_diagnostics(list);
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef DIAG_H
+#define DIAG_H
+
+#include <stddef.h>
+
+/*
+ * Error messages collected during one compilation. The parser and the
+ * semantic checks report here instead of writing to a stream, so a library
+ * caller decides where they go.
+ */
+typedef struct {
+    char** messages;
+    size_t count;
+    size_t capacity;
+} diag_list_t;
+
+void init_diagnostics(diag_list_t* list);
+
+void report(diag_list_t* list, const char* format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+void clear_diagnostics(diag_list_t* list);
+
+void free_diagnostics(diag_list_t* list);
+
+#endif
@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+/*
+ * Constant folding over the flat AST. The folded tree is written out in
+ * preorder like the original; a subtree that folds to a number is emitted
+ * first and then rewound to a single AST_NUM node, so nothing is evaluated
+ * twice. Folding only ever shrinks the tree, so the output is allocated once
+ * at the size of the input.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "fold.h"
+
+typedef struct {
+    const flat_ast_t* ast;
+    symtab_t* table;
+    flat_ast_t* out;
+} folder_t;
+
+/* Copy node without its children; its size is set by close_node() */
+static size_t emit(folder_t* f, size_t node)
+{
+    size_t index = f->out->count++;
+    f->out->nodes[index] = f->ast->nodes[node];
+    f->out->nodes[index].size = 1;
+    return index;
+}
+
+static void close_node(folder_t* f, size_t index)
+{
+    f->out->nodes[index].size = f->out->count - index;
+}
+
+static void emit_num(folder_t* f, int64_t value)
+{
+    flat_node_t* node = &f->out->nodes[f->out->count++];
+    node->label = AST_NUM;
+    node->payload = f->out->num_count;
+    node->size = 1;
+    f->out->nums[f->out->num_count++] = value;
+}
+
+static void emit_empty_block(folder_t* f)
+{
+    flat_node_t* node = &f->out->nodes[f->out->count++];
+    node->label = AST_STMT_BLOCK;
+    node->payload = NO_IDENT;
+    node->size = 1;
+}
+
+/* Drop everything emitted since the node at index */
+static void rewind_to(folder_t* f, size_t index, size_t num_count)
+{
+    f->out->count = index;
+    f->out->num_count = num_count;
+}
+
+/* Copy the subtree at node as it is; only numbers are moved to the new table */
+static void copy_subtree(folder_t* f, size_t node)
+{
+    for (size_t i = node; i < flat_end(f->ast, node); i++) {
+        if (flat_label(f->ast, i) == AST_NUM) {
+            emit_num(f, flat_num(f->ast, i));
+        } else {
+            f->out->nodes[f->out->count++] = f->ast->nodes[i];
+        }
+    }
+}
+
+/* Arithmetic wraps around like the IR's; division that would trap is left alone */
+static bool evaluate(ast_label_t op, int64_t lhs, int64_t rhs, int64_t* result)
+{
+    switch (op) {
+        case AST_ADD:
+            *result = (int64_t)((uint64_t)lhs + (uint64_t)rhs);
+            return true;
+        case AST_SUB:
+            *result = (int64_t)((uint64_t)lhs - (uint64_t)rhs);
+            return true;
+        case AST_MUL:
+            *result = (int64_t)((uint64_t)lhs * (uint64_t)rhs);
+            return true;
+        case AST_DIV:
+            if (rhs == 0 || (lhs == INT64_MIN && rhs == -1))
+                return false;
+            *result = lhs / rhs;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Emit the folded expression; returns whether it folded to the number *value */
+static bool fold_expression(folder_t* f, size_t node, int64_t* value)
+{
+    const flat_ast_t* ast = f->ast;
+    ast_label_t label = flat_label(ast, node);
+
+    if (label == AST_NUM) {
+        *value = flat_num(ast, node);
+        emit_num(f, *value);
+        return true;
+    }
+
+    if (label == AST_IDENT) {
+        symbol_t* sym = lookup(f->table, flat_ident(ast, node));
+        if (sym && sym->type == SYM_CONST) {
+            *value = sym->constant;
+            emit_num(f, *value);
+            return true;
+        }
+        emit(f, node);
+        return false;
+    }
+
+    /*
+     * Operators have two operands, except where a unary minus left one behind;
+     * those are folded inside but never evaluated
+     */
+    size_t start = emit(f, node);
+    size_t num_count = f->out->num_count;
+    int64_t operands[2];
+    size_t count = 0;
+    bool known = true;
+    FOR_EACH_CHILD(ast, node, child)
+    {
+        int64_t operand = 0;
+        known &= fold_expression(f, child, &operand);
+        if (count < 2)
+            operands[count] = operand;
+        count++;
+    }
+
+    if (known && count == 2 && evaluate(label, operands[0], operands[1], value)) {
+        rewind_to(f, start, num_count);
+        emit_num(f, *value);
+        return true;
+    }
+    close_node(f, start);
+    return false;
+}
+
+/* Emit the folded condition; returns 1 or 0 if it is known to hold or not, or -1 */
+static int fold_condition(folder_t* f, size_t node)
+{
+    const flat_ast_t* ast = f->ast;
+    ast_label_t label = flat_label(ast, node);
+    size_t start = emit(f, node);
+
+    size_t lhs_node = flat_first_child(node);
+    int64_t lhs = 0;
+    int64_t rhs = 0;
+    bool known = fold_expression(f, lhs_node, &lhs);
+    if (label != AST_ODD) {
+        bool rhs_known = fold_expression(f, flat_next_sibling(ast, lhs_node), &rhs);
+        known = known && rhs_known;
+    }
+    close_node(f, start);
+
+    if (!known)
+        return -1;
+
+    switch (label) {
+        case AST_ODD:
+            return lhs % 2 != 0;
+        case AST_GTE:
+            return lhs >= rhs;
+        case AST_LTE:
+            return lhs <= rhs;
+        case AST_GT:
+            return lhs > rhs;
+        case AST_LT:
+            return lhs < rhs;
+        case AST_EQ:
+            return lhs == rhs;
+        case AST_NEQ:
+            return lhs != rhs;
+        default:
+            return -1;
+    }
+}
+
+/*
+ * Emit the folded statement. Inside a statement block, nested blocks are
+ * spliced into it and a statement that folds away leaves nothing; elsewhere it
+ * leaves an empty block, since IF, WHILE and the program need a statement.
+ */
+static void fold_statement(folder_t* f, size_t node, bool in_block)
+{
+    const flat_ast_t* ast = f->ast;
+    ast_label_t label = flat_label(ast, node);
+
+    if (label == AST_STMT_BLOCK) {
+        size_t start = in_block ? 0 : emit(f, node);
+        FOR_EACH_CHILD(ast, node, statement)
+        {
+            fold_statement(f, statement, true);
+        }
+        if (!in_block)
+            close_node(f, start);
+    }
+
+    else if (label == AST_ASSIGN) {
+        size_t start = emit(f, node);
+        size_t lhs_node = flat_first_child(node);
+        int64_t value;
+        copy_subtree(f, lhs_node);
+        fold_expression(f, flat_next_sibling(ast, lhs_node), &value);
+        close_node(f, start);
+    }
+
+    else if (label == AST_PRINT) {
+        size_t start = emit(f, node);
+        int64_t value;
+        fold_expression(f, flat_first_child(node), &value);
+        close_node(f, start);
+    }
+
+    else if (label == AST_IF || label == AST_WHILE) {
+        size_t start = emit(f, node);
+        size_t num_count = f->out->num_count;
+        size_t condition = flat_first_child(node);
+        size_t then_node = flat_next_sibling(ast, condition);
+        size_t else_node = flat_next_sibling(ast, then_node);
+        size_t end = flat_end(ast, node);
+
+        int holds = fold_condition(f, condition);
+
+        /* a loop that never ends stays as it is */
+        if (holds < 0 || (label == AST_WHILE && holds)) {
+            fold_statement(f, then_node, false);
+            if (else_node < end)
+                fold_statement(f, else_node, false);
+            close_node(f, start);
+            return;
+        }
+
+        rewind_to(f, start, num_count);
+        size_t taken = label == AST_IF && holds ? then_node : else_node;
+        if (taken < end) {
+            fold_statement(f, taken, in_block);
+        } else if (!in_block) {
+            emit_empty_block(f);
+        }
+    }
+
+    else { // CALL and SCAN have nothing to fold
+        copy_subtree(f, node);
+    }
+}
+
+/* Declarations of a program or procedure body, followed by its statement */
+static void fold_block(folder_t* f, size_t node)
+{
+    const flat_ast_t* ast = f->ast;
+    size_t start = emit(f, node);
+
+    FOR_EACH_CHILD(ast, node, current)
+    {
+        ast_label_t label = flat_label(ast, current);
+
+        if (label == AST_CONST_DECL) {
+            FOR_EACH_CHILD(ast, current, c_ident)
+            {
+                symbol_t* sym =
+                    insert_sym(f->table, flat_ident(ast, c_ident), SYM_CONST, NULL);
+                sym->constant = flat_num(ast, flat_first_child(c_ident));
+            }
+            /* every use is replaced by its value, so the declaration goes */
+        }
+
+        else if (label == AST_VAR_DECL) {
+            /* VARs shadow CONSTs of the same name */
+            FOR_EACH_CHILD(ast, current, c_ident)
+            {
+                insert_sym(f->table, flat_ident(ast, c_ident), SYM_VAR, NULL);
+            }
+            copy_subtree(f, current);
+        }
+
+        else if (label == AST_PROC_DECL) {
+            size_t proc_start = emit(f, current);
+            size_t head = flat_first_child(current);
+            insert_sym(f->table, flat_ident(ast, head), SYM_PROCEDURE, NULL);
+            copy_subtree(f, head);
+
+            push_scope(f->table);
+            fold_block(f, flat_next_sibling(ast, head));
+            pop_scope(f->table);
+            close_node(f, proc_start);
+        }
+
+        else {
+            fold_statement(f, current, false);
+        }
+    }
+
+    close_node(f, start);
+}
+
+bool fold_constants(const flat_ast_t* ast, symtab_t* table, flat_ast_t* folded)
+{
+    folded->nodes = malloc(ast->count * sizeof(flat_node_t));
+    folded->nums = malloc(ast->count * sizeof(int64_t));
+    folded->count = 0;
+    folded->num_count = 0;
+    if (!folded->nodes || !folded->nums) {
+        free_flat_ast(folded);
+        return false;
+    }
+
+    folder_t f = { ast, table, folded };
+    if (ast->count) {
+        push_scope(table); // globals
+        fold_block(&f, 0);
+        pop_scope(table);
+    }
+    return true;
+}
@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef FOLD_H
+#define FOLD_H
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "symtab.h"
+
+/*
+ * Copy ast to folded with CONST identifiers replaced by their values,
+ * arithmetic on constants evaluated, and IF and WHILE statements whose
+ * condition is known dropped or replaced by the branch taken. CONST
+ * declarations are left out, as nothing refers to them any more. Expects an
+ * ast that passed the semantic checks; table must have no open scopes.
+ * Returns false if out of memory.
+ */
+bool fold_constants(const flat_ast_t* ast, symtab_t* table, flat_ast_t* folded);
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hash.h"
+
+void init_hasher(hasher_t* h)
+{
+    h->a = 14695981039346656037u;
+    h->b = 0x9e3779b97f4a7c15u;
+}
+
+void hash_bytes(hasher_t* h, const void* data, size_t len)
+{
+    const unsigned char* p = data;
+    for (size_t i = 0; i < len; i++) {
+        h->a = (h->a ^ p[i]) * 1099511628211u;
+        h->b = (h->b ^ p[i]) * 0xff51afd7ed558ccdu;
+        h->b ^= h->b >> 32;
+    }
+}
+
+void hash_field(hasher_t* h, const void* data, size_t len)
+{
+    uint64_t len64 = len;
+    hash_bytes(h, &len64, sizeof(len64));
+    hash_bytes(h, data, len);
+}
+
+void hash_string(hasher_t* h, const char* s)
+{
+    hash_field(h, s ? s : "", s ? strlen(s) : 0);
+}
+
+static uint64_t fmix64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdu;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53u;
+    k ^= k >> 33;
+    return k;
+}
+
+void hash_hex(const hasher_t* h, char hex[HASH_HEX_LEN + 1])
+{
+    snprintf(hex, HASH_HEX_LEN + 1, "%016llx%016llx",
+             (unsigned long long)fmix64(h->a), (unsigned long long)fmix64(h->b));
+}
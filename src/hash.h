@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HASH_HEX_LEN 32
+
+/*
+ * 128-bit hash for naming compiler output by its inputs, in two 64-bit lanes:
+ * FNV-1a, and a multiply-xorshift lane so the halves don't collide together.
+ * Both are finished with murmur3's fmix64.
+ */
+typedef struct {
+    uint64_t a;
+    uint64_t b;
+} hasher_t;
+
+void init_hasher(hasher_t* h);
+
+void hash_bytes(hasher_t* h, const void* data, size_t len);
+
+/* Length first, so that no two sequences of fields hash the same bytes */
+void hash_field(hasher_t* h, const void* data, size_t len);
+
+/* A NULL string hashes like "" */
+void hash_string(hasher_t* h, const char* s);
+
+void hash_hex(const hasher_t* h, char hex[HASH_HEX_LEN + 1]);
+
+#endif
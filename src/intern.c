@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+/*
+ * Open addressing hash table from spelling to ID. Spellings are copied into
+ * fixed size chunks that are never moved, so pointers handed out by
+ * interned_string() stay valid while more identifiers are added.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+
+#define CHUNK_SIZE (64 * 1024)
+
+typedef struct intern_chunk {
+    struct intern_chunk* prev;
+    size_t used;
+    size_t size;
+    char text[];
+} chunk_t;
+
+/* 32-bit FNV-1a */
+static uint32_t hash_text(const char* text, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)text[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void init_intern_table(intern_table_t* table)
+{
+    memset(table, 0, sizeof(*table));
+}
+
+static char* store_text(intern_table_t* table, const char* text, size_t len)
+{
+    chunk_t* chunks = table->chunks;
+    if (!chunks || chunks->size - chunks->used < len + 1) {
+        size_t size = len + 1 > CHUNK_SIZE ? len + 1 : CHUNK_SIZE;
+        chunk_t* chunk = malloc(sizeof(chunk_t) + size);
+        if (!chunk)
+            return NULL;
+        chunk->prev = chunks;
+        chunk->used = 0;
+        chunk->size = size;
+        chunks = table->chunks = chunk;
+    }
+
+    char* copy = chunks->text + chunks->used;
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+    chunks->used += len + 1;
+    return copy;
+}
+
+static bool grow_slots(intern_table_t* table)
+{
+    size_t new_count = table->slot_count ? table->slot_count * 2 : 1024;
+    uint32_t* new_slots = calloc(new_count, sizeof(uint32_t));
+    if (!new_slots)
+        return false;
+
+    size_t mask = new_count - 1;
+    for (size_t id = 1; id < table->entry_count; id++) {
+        size_t i = table->entries[id].hash & mask;
+        while (new_slots[i] != NO_IDENT)
+            i = (i + 1) & mask;
+        new_slots[i] = id;
+    }
+
+    free(table->slots);
+    table->slots = new_slots;
+    table->slot_count = new_count;
+    return true;
+}
+
+static bool add_entry(intern_table_t* table, const char* text, uint32_t len,
+                      uint32_t hash)
+{
+    if (table->entry_count == table->entry_capacity) {
+        size_t capacity = table->entry_capacity ? table->entry_capacity * 2 : 512;
+        intern_entry_t* grown =
+            realloc(table->entries, capacity * sizeof(intern_entry_t));
+        if (!grown)
+            return false;
+        table->entries = grown;
+        table->entry_capacity = capacity;
+    }
+
+    intern_entry_t* e = &table->entries[table->entry_count++];
+    e->text = text;
+    e->len = len;
+    e->hash = hash;
+    return true;
+}
+
+/*
+ * Return the ID for text, adding it to the table on first sight. Returns
+ * NO_IDENT only if memory runs out.
+ */
+uint32_t intern(intern_table_t* table, const char* text, size_t len)
+{
+    // reserve NO_IDENT
+    if (table->entry_count == 0 && !add_entry(table, "", 0, 0))
+        return NO_IDENT;
+
+    /* keep the load factor at or below 1/2 */
+    if (2 * table->entry_count >= table->slot_count && !grow_slots(table))
+        return NO_IDENT;
+
+    uint32_t hash = hash_text(text, len);
+    size_t mask = table->slot_count - 1;
+    size_t i = hash & mask;
+
+    while (table->slots[i] != NO_IDENT) {
+        intern_entry_t* e = &table->entries[table->slots[i]];
+        if (e->hash == hash && e->len == len && memcmp(e->text, text, len) == 0)
+            return table->slots[i];
+        i = (i + 1) & mask;
+    }
+
+    char* copy = store_text(table, text, len);
+    if (!copy || !add_entry(table, copy, len, hash))
+        return NO_IDENT;
+
+    table->slots[i] = table->entry_count - 1;
+    return table->slots[i];
+}
+
+const char* interned_string(const intern_table_t* table, uint32_t id)
+{
+    return id < table->entry_count ? table->entries[id].text : "";
+}
+
+size_t interned_length(const intern_table_t* table, uint32_t id)
+{
+    return id < table->entry_count ? table->entries[id].len : 0;
+}
+
+uint32_t interned_hash(const intern_table_t* table, uint32_t id)
+{
+    return id < table->entry_count ? table->entries[id].hash : 0;
+}
+
+/* Number of distinct identifiers, not counting NO_IDENT */
+size_t interned_count(const intern_table_t* table)
+{
+    return table->entry_count ? table->entry_count - 1 : 0;
+}
+
+void free_interned(intern_table_t* table)
+{
+    while (table->chunks) {
+        chunk_t* prev = table->chunks->prev;
+        free(table->chunks);
+        table->chunks = prev;
+    }
+    free(table->entries);
+    free(table->slots);
+    init_intern_table(table);
+}
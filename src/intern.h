@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Identifiers are interned once by the lexer. Every distinct spelling gets a
+ * 32-bit ID, so the AST and the symbol table compare names as integers.
+ * ID 0 is reserved for nodes and tokens that carry no identifier.
+ */
+#define NO_IDENT 0
+
+struct intern_chunk;
+
+typedef struct {
+    const char* text;
+    uint32_t len;
+    uint32_t hash;
+} intern_entry_t;
+
+typedef struct {
+    struct intern_chunk* chunks;
+    intern_entry_t* entries; // indexed by ID
+    size_t entry_count;
+    size_t entry_capacity;
+    uint32_t* slots; // ID per slot, NO_IDENT if empty
+    size_t slot_count;
+} intern_table_t;
+
+void init_intern_table(intern_table_t* table);
+
+uint32_t intern(intern_table_t* table, const char* text, size_t len);
+
+/* NUL terminated spelling, valid until free_interned() */
+const char* interned_string(const intern_table_t* table, uint32_t id);
+
+size_t interned_length(const intern_table_t* table, uint32_t id);
+
+uint32_t interned_hash(const intern_table_t* table, uint32_t id);
+
+size_t interned_count(const intern_table_t* table);
+
+void free_interned(intern_table_t* table);
+
+#endif
@@ -4,265 +4,240 @@
  * See LICENSE for more details.
  */
 
-#define _POSIX_C_SOURCE 200809L // for using open_memstream
-#include <ctype.h>
-#include <stdio.h>
-#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 
+#include "charclass.h"
+#include "intern.h"
 #include "lexer.h"
+#include "source.h"
 
-static bool valid_char(char c);
-static void set_keyword(token_t* t);
+static token_symbol_t keyword_symbol(const char* text, size_t len);
 
-static bool valid_char(char c)
+/*
+ * Convert a run of digits, returning false if the value doesn't fit in an
+ * int64_t
+ */
+static bool parse_number(const char* start, const char* end, int64_t* value)
 {
-    return isspace(c) || isalnum(c) || c == '+' || c == '-' || c == '*' ||
-           c == '/' || c == '=' || c == '<' || c == '>' || c == ',' || c == ':' ||
-           c == ';' || c == '_' || c == '!' || c == '(' || c == ')';
+    int64_t n = 0;
+    for (const char* p = start; p < end; p++) {
+        int digit = *p - '0';
+        if (n > (INT64_MAX - digit) / 10) {
+            return false;
+        }
+        n = n * 10 + digit;
+    }
+    *value = n;
+    return true;
 }
 
 /*
- * Scan entire source file
+ * Scan entire source file. Regular files are memory mapped, anything else
+ * (including "-" for stdin) is read into a buffer first. Tokens refer back
+ * into the source, so the caller releases it once the stream is no longer
+ * needed.
  */
-bool scan(const char* source, char** buf)
+bool scan(const char* path, source_t* source, token_stream_t* tokens,
+          intern_table_t* names)
 {
-    token_t token_holder;
-    size_t init_len = 0;
-    FILE* fin = fopen(source, "r");
-    if (!fin) {
+    if (!load_source(path, source)) {
         return false;
     }
 
-    /* file stream associated with memory buffer */
-    FILE* token_stream = open_memstream(buf, &init_len);
-
-    int i = 0;
-    char c = ' ';
-
-    while (c != EOF) {
-        if (c == '#') { // single line comments starting with #
-            while (c != '\n') {
-                c = fgetc(fin);
-            }
-        }
-
-        if (!valid_char(c)) {
-            clear_token(&token_holder);
-            token_holder.symbol = ERROR;
-            i = 0;
-            while (c != EOF && !valid_char(c)) {
-                token_holder.value[i++] = c;
-                c = fgetc(fin);
-            }
-        }
-
-        else if (isspace(c)) {
-            while (isspace(c)) {
-                c = fgetc(fin);
-            }
-            continue;
-        }
-
-        else if (isdigit(c)) {
-            clear_token(&token_holder);
-            token_holder.symbol = NUM;
-            i = 0;
-            while (isdigit(c)) {
-                token_holder.value[i++] = c;
-                token_holder.num_value *= 10;
-                token_holder.num_value += (c - 48);
-                c = fgetc(fin);
-            }
-        }
-
-        else if (isalpha(c) || c == '_') {
-            clear_token(&token_holder);
-            i = 0;
-            token_holder.symbol = IDENT;
-            while (isalnum(c) || c == '_') {
-                token_holder.value[i++] = c;
-                c = fgetc(fin);
-            }
-            set_keyword(&token_holder);
-        }
-
-        else if (c == '+') {
-            clear_token(&token_holder);
-            token_holder.symbol = PLUS;
-            token_holder.value[0] = '+';
-            c = fgetc(fin);
-        }
+    if (!scan_buffer(source->text, source->len, tokens, names)) {
+        release_source(source);
+        return false;
+    }
+    return true;
+}
 
-        else if (c == '-') {
-            clear_token(&token_holder);
-            token_holder.symbol = MINUS;
-            token_holder.value[0] = '-';
-            c = fgetc(fin);
-        }
+/*
+ * Scan len bytes of source text. The text need not be NUL terminated.
+ * Identifiers are interned into names.
+ */
+bool scan_buffer(const char* text, size_t len, token_stream_t* tokens,
+                 intern_table_t* names)
+{
+    /* token offsets and lengths are 32 bits wide */
+    if (len > UINT32_MAX) {
+        return false;
+    }
 
-        else if (c == '*') {
-            clear_token(&token_holder);
-            token_holder.symbol = TIMES;
-            token_holder.value[0] = '*';
-            c = fgetc(fin);
-        }
+    /* Roughly one token per 4 bytes of source; the arrays grow if needed */
+    if (!init_token_stream(tokens, text, len / 4 + 16)) {
+        return false;
+    }
 
-        else if (c == '/') {
-            clear_token(&token_holder);
-            token_holder.symbol = SLASH;
-            token_holder.value[0] = '/';
-            c = fgetc(fin);
-        }
+    const char* p = text;
+    const char* end = text + len;
+    const char* start = NULL;
+    bool ok = true;
 
-        else if (c == ',') {
-            clear_token(&token_holder);
-            token_holder.symbol = COMMA;
-            token_holder.value[0] = ',';
-            c = fgetc(fin);
-        }
+    while (p < end && ok) {
+        char c = *p;
+        uint8_t cls = char_class[(unsigned char)c];
+        token_symbol_t symbol = ERROR;
 
-        else if (c == ':') {
-            clear_token(&token_holder);
-            token_holder.symbol = COLON;
-            token_holder.value[0] = ':';
-            c = fgetc(fin);
+        if (cls & CC_COMMENT) { // single line comments starting with #
+            p = skip_comment(p, end);
+            continue;
         }
 
-        else if (c == ';') {
-            clear_token(&token_holder);
-            token_holder.symbol = SEMICOLON;
-            token_holder.value[0] = ';';
-            c = fgetc(fin);
+        if (cls & CC_SPACE) {
+            p = skip_space(p, end);
+            continue;
         }
 
-        else if (c == '!') {
-            clear_token(&token_holder);
-            token_holder.value[0] = '!';
-            c = fgetc(fin);
-            // Check for next '=' char
-            if (c == '=') {
-                token_holder.symbol = NOTEQUAL;
-                token_holder.value[1] = '=';
-                c = fgetc(fin);
-            }
+        start = p;
 
-            else {
-                token_holder.symbol = ERROR;
-                c = fgetc(fin);
+        if (!(cls & CC_VALID)) {
+            while (p < end && !is_class(*p, CC_VALID)) {
+                p++;
             }
         }
 
-        else if (c == '>') {
-            clear_token(&token_holder);
-            token_holder.symbol = GREATER;
-            token_holder.value[0] = '>';
-            c = fgetc(fin);
-            // Check for next '=' char
-            if (c == '=') {
-                token_holder.symbol = GTE;
-                token_holder.value[1] = '=';
-                c = fgetc(fin);
+        else if (cls & CC_DIGIT) {
+            int64_t num_value = 0;
+            p = skip_digits(p, end);
+            /* too large literals stay ERROR tokens, reported by the parser */
+            if (parse_number(start, p, &num_value)) {
+                symbol = NUM;
+                ok = push_num(tokens, num_value);
             }
         }
 
-        else if (c == '<') {
-            clear_token(&token_holder);
-            token_holder.symbol = LESSER;
-            token_holder.value[0] = '<';
-            c = fgetc(fin);
-            // Check for next '=' char
-            if (c == '=') {
-                token_holder.symbol = LTE;
-                token_holder.value[1] = '=';
-                c = fgetc(fin);
+        else if (cls & CC_ALPHA) {
+            p = skip_ident(p, end);
+            symbol = keyword_symbol(start, p - start);
+            if (symbol == IDENT) {
+                uint32_t id = intern(names, start, p - start);
+                ok = id != NO_IDENT && push_ident(tokens, id);
             }
         }
 
-        else if (c == '=') {
-            clear_token(&token_holder);
-            token_holder.symbol = ASSIGN;
-            token_holder.value[0] = '=';
-            c = fgetc(fin);
-            // Check for next '=' char
-            if (c == '=') {
-                token_holder.symbol = EQUAL;
-                token_holder.value[1] = '=';
-                c = fgetc(fin);
+        else {
+            p++;
+            /* two character operators end with '=' */
+            bool eq_next = p < end && *p == '=';
+
+            switch (c) {
+                case '+':
+                    symbol = PLUS;
+                    break;
+                case '-':
+                    symbol = MINUS;
+                    break;
+                case '*':
+                    symbol = TIMES;
+                    break;
+                case '/':
+                    symbol = SLASH;
+                    break;
+                case ',':
+                    symbol = COMMA;
+                    break;
+                case ':':
+                    symbol = COLON;
+                    break;
+                case ';':
+                    symbol = SEMICOLON;
+                    break;
+                case '(':
+                    symbol = LPAREN;
+                    break;
+                case ')':
+                    symbol = RPAREN;
+                    break;
+                case '!':
+                    symbol = eq_next ? NOTEQUAL : ERROR;
+                    p += eq_next;
+                    break;
+                case '>':
+                    symbol = eq_next ? GTE : GREATER;
+                    p += eq_next;
+                    break;
+                case '<':
+                    symbol = eq_next ? LTE : LESSER;
+                    p += eq_next;
+                    break;
+                case '=':
+                    symbol = eq_next ? EQUAL : ASSIGN;
+                    p += eq_next;
+                    break;
             }
         }
 
-        else if (c == '(') {
-            clear_token(&token_holder);
-            token_holder.symbol = LPAREN;
-            token_holder.value[0] = '(';
-            c = fgetc(fin);
-        }
-
-        else if (c == ')') {
-            clear_token(&token_holder);
-            token_holder.symbol = RPAREN;
-            token_holder.value[0] = ')';
-            c = fgetc(fin);
-        }
-
-        /*
-         * Write token to token_stream, basically it is pushed to the
-         * dynamic memory buffer associated with token_stream
-         */
-        fwrite(&token_holder, 1, sizeof(token_holder), token_stream);
-        fflush(token_stream);
+        ok = ok && push_token(tokens, symbol, start - text, p - start);
     }
 
-    clear_token(&token_holder);
-    token_holder.symbol = LIST_END;
-    fwrite(&token_holder, 1, sizeof(token_holder), token_stream);
-    fflush(token_stream);
-    fclose(token_stream);
+    if (!ok || !push_token(tokens, LIST_END, len, 0)) {
+        free_token_stream(tokens);
+        return false;
+    }
     return true;
 }
 
 /*
- * Set symbol to respective keyword if it's string matches that keyword
+ * Keywords are recognised with a minimal perfect hash over the identifier's
+ * length and its case-folded first and last characters:
+ *
+ *     key  = len << 16 | (first | 0x20) << 8 | (last | 0x20)
+ *     slot = ((key * KEYWORD_HASH_MUL) mod 2^32) * 12 / 2^32
+ *
+ * KEYWORD_HASH_MUL is the first odd multiplier for which the 12 keywords land
+ * in 12 distinct slots; rerun that search if a keyword is added. A single
+ * case-insensitive compare against the slot's keyword then confirms the
+ * match. OR-ing with 0x20 folds letters to lower case and leaves digits
+ * alone, while '_' becomes 0x7f, so no identifier can fold onto a keyword
+ * unless it spells one.
  */
-static void set_keyword(token_t* t)
+#define KEYWORD_HASH_MUL 0x20a711u
+#define KEYWORD_COUNT 12
+#define KEYWORD_MIN_LEN 2
+#define KEYWORD_MAX_LEN 9
+
+typedef struct {
+    const char name[KEYWORD_MAX_LEN + 1]; // lower case
+    uint8_t len;
+    token_symbol_t symbol;
+} keyword_t;
+
+/* Indexed by keyword_slot() */
+static const keyword_t keywords[KEYWORD_COUNT] = {
+    { "var", 3, VAR },     { "odd", 3, ODD },     { "procedure", 9, PROCEDURE },
+    { "call", 4, CALL },   { "scan", 4, SCAN },   { "while", 5, WHILE },
+    { "else", 4, ELSE },   { "print", 5, PRINT }, { "if", 2, IF },
+    { "begin", 5, BEGIN }, { "end", 3, END },     { "const", 5, CONST },
+};
+
+static inline uint32_t keyword_slot(const char* text, size_t len)
 {
-    /*
-     * Making keywords case insensitive.
-     * The original string associated with the token is not affected
-     */
-    char string[32];
-    char* c_ptr = string;
+    uint32_t first = (unsigned char)text[0] | 0x20;
+    uint32_t last = (unsigned char)text[len - 1] | 0x20;
+    uint32_t key = (uint32_t)len << 16 | first << 8 | last;
+    return (uint32_t)(((uint64_t)(key * KEYWORD_HASH_MUL) * KEYWORD_COUNT) >> 32);
+}
 
-    strcpy(string, t->value);
+/*
+ * Return the keyword symbol for an identifier, or IDENT if it isn't one.
+ * Keywords are case insensitive.
+ */
+static token_symbol_t keyword_symbol(const char* text, size_t len)
+{
+    if (len < KEYWORD_MIN_LEN || len > KEYWORD_MAX_LEN) {
+        return IDENT;
+    }
 
-    while (*c_ptr) {
-        *c_ptr = toupper(*c_ptr);
-        c_ptr++;
+    const keyword_t* kw = &keywords[keyword_slot(text, len)];
+    if (kw->len != len) {
+        return IDENT;
     }
 
-    if (strcmp(string, "CONST") == 0)
-        t->symbol = CONST;
-    else if (strcmp(string, "VAR") == 0)
-        t->symbol = VAR;
-    else if (strcmp(string, "PROCEDURE") == 0)
-        t->symbol = PROCEDURE;
-    else if (strcmp(string, "CALL") == 0)
-        t->symbol = CALL;
-    else if (strcmp(string, "BEGIN") == 0)
-        t->symbol = BEGIN;
-    else if (strcmp(string, "END") == 0)
-        t->symbol = END;
-    else if (strcmp(string, "IF") == 0)
-        t->symbol = IF;
-    else if (strcmp(string, "ELSE") == 0)
-        t->symbol = ELSE;
-    else if (strcmp(string, "WHILE") == 0)
-        t->symbol = WHILE;
-    else if (strcmp(string, "ODD") == 0)
-        t->symbol = ODD;
-    else if (strcmp(string, "PRINT") == 0)
-        t->symbol = PRINT;
-    else if (strcmp(string, "SCAN") == 0)
-        t->symbol = SCAN;
-}
\ No newline at end of file
+    for (size_t i = 0; i < len; i++) {
+        if ((text[i] | 0x20) != kw->name[i]) {
+            return IDENT;
+        }
+    }
+    return kw->symbol;
+}
@@ -7,9 +7,16 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "intern.h"
+#include "source.h"
 #include "token.h"
 #include <stdbool.h>
+#include <stddef.h>
 
-bool scan(const char* source, char** buf);
+bool scan(const char* path, source_t* source, token_stream_t* tokens,
+          intern_table_t* names);
+
+bool scan_buffer(const char* text, size_t len, token_stream_t* tokens,
+                 intern_table_t* names);
 
 #endif
\ No newline at end of file
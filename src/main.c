@@ -4,108 +4,283 @@
  * See LICENSE for more details.
  */
 
-#include <assert.h>
+#define _POSIX_C_SOURCE 200809L
+#include <limits.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-#include <llvm-c/Analysis.h>
-#include <llvm-c/Core.h>
+#include "batch.h"
 
-#include "ast.h"
-#include "codegen.h"
-#include "lexer.h"
-#include "parser.h"
-#include "symtab.h"
-#include "token.h"
+#define RUNTIME_NAME "libpl0rt.a"
+#define DEFAULT_CACHE_MB 512
 
-int main(int argc, char** argv)
+/*
+ * The runtime library is installed next to the pl0c executable, unless
+ * PL0C_RUNTIME names another one. The result is never freed.
+ */
+static const char* find_runtime()
 {
-    char* file_name = NULL;
+    const char* runtime = getenv("PL0C_RUNTIME");
+    if (runtime && *runtime)
+        return runtime;
 
-    switch (argc) {
-        case 1:
-            fprintf(stderr, "error: no input file\n");
-            exit(EXIT_FAILURE);
+    static char path[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len <= 0)
+        return RUNTIME_NAME;
+    path[len] = '\0';
 
-        case 2:
-            file_name = argv[1];
-            break;
+    char* slash = strrchr(path, '/');
+    size_t dir_len = slash ? (size_t)(slash - path + 1) : 0;
+    if (dir_len + sizeof(RUNTIME_NAME) > sizeof(path))
+        return RUNTIME_NAME;
+    memcpy(path + dir_len, RUNTIME_NAME, sizeof(RUNTIME_NAME));
+    return path;
+}
 
-        default:
-            fprintf(stderr, "Usage: %s <file_name>.pl0\n", argv[0]);
-            exit(EXIT_FAILURE);
+/*
+ * The cache of default_cache_dir(), limited to $PL0C_CACHE_SIZE megabytes.
+ * Returns NULL, after a warning, if it can't be used.
+ */
+static cache_t* open_shared_cache(cache_t* cache)
+{
+    const char* size = getenv("PL0C_CACHE_SIZE");
+    char* end = NULL;
+    long long megabytes = size && *size ? strtoll(size, &end, 10) : DEFAULT_CACHE_MB;
+    if ((end && *end) || megabytes < 0) {
+        fprintf(stderr, "warning: PL0C_CACHE_SIZE is not a size in MB, using %d\n",
+                DEFAULT_CACHE_MB);
+        megabytes = DEFAULT_CACHE_MB;
     }
 
-    char* token_buf;
-    if (!scan(file_name, &token_buf)) {
-        fprintf(stderr, "error: %s not found\n", file_name);
-        exit(EXIT_FAILURE);
+    char* dir = default_cache_dir();
+    bool ok = dir && open_cache(cache, dir, (uint64_t)megabytes * 1000 * 1000);
+    if (!ok) {
+        fprintf(stderr, "warning: cannot use the cache in %s\n",
+                dir ? dir : "$HOME/.cache");
     }
+    free(dir);
+    return ok ? cache : NULL;
+}
 
-    /* Memory buffer to be associated with the token stream */
-    token_t* token_list = (token_t*)(token_buf);
-    /*
-    token_t *token_ptr = token_list;
-    while (token_list->symbol != LIST_END) {
-            print_token(*(token_list));
-            token_list++;
-    }*/
-
-    set_token_ptr(&token_list);
-    ast_node_t* root = parse();
-
-    if (syntax_error()) {
-        cleanup_ast(&root);
-        assert(root == NULL);
-        assert(ast_node_count() == 0);
-        exit(EXIT_FAILURE);
-    }
+static void usage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <file_name>.pl0|.bc ... | @<response_file> | -\n"
+            "  -o <file>          write output to file (single source only)\n"
+            "  -c                 write an object file\n"
+            "  -S                 write an assembly file\n"
+            "  -emit-llvm         write LLVM IR as text\n"
+            "  -emit-bc           write LLVM bitcode\n"
+            "                     (otherwise an executable is linked)\n"
+            "  --run              JIT compile a single source and run it\n"
+            "  -O0 .. -O3         optimization level (default -O0)\n"
+            "  -passes=<pipeline> run this pass pipeline instead, as opt -passes\n"
+            "  -fssa              generate SSA values for locals, not stack slots\n"
+            "  -fwhole-program    make everything but main internal to the module\n"
+            "  -fstrict-overflow  treat signed overflow as undefined\n"
+            "  -remarks           list procedures dropped as never called\n"
+            "  --stats            time each phase and count what it made\n"
+            "  -ftime-trace[=<file>] also write the phases as Chrome trace\n"
+            "                     events, to pl0c-trace.json by default\n"
+            "  --cache            reuse output of earlier identical compilations\n"
+            "  -fincremental      with --cache, link executables from an object\n"
+            "                     per procedure, compiling only those that changed\n"
+            "  -j N               compile on N worker threads, 0 for one per CPU\n"
+            "  @file              read further file names from file\n",
+            program);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+    file_list_t files = { 0 };
+    pl0c_options_t options = { 0 };
+    output_t output = { 0 };
+    bool object = false;
+    bool assembly = false;
+    bool emit_llvm = false;
+    bool emit_bc = false;
+    bool run = false;
+    bool use_cache = false;
+    bool incremental = false;
+    int jobs = 1;
+    bool batch = false;
 
-    // printf("%zu\n", ast_node_count());
-    // print_ast(root);
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
 
-    symbol_t* symbol_table = NULL;
-    size_t current_level = 0;
-    run_semantic_checks(root, &symbol_table, &current_level);
+        if (strncmp(arg, "-j", 2) == 0) {
+            const char* count = arg[2] ? arg + 2 : NULL;
+            if (!count && i + 1 < argc) {
+                count = argv[++i];
+            }
+            char* end = NULL;
+            long n = count ? strtol(count, &end, 10) : -1;
+            if (!count || *end || n < 0 || n > 1024) {
+                usage(argv[0]);
+            }
+            jobs = (int)n;
+            batch = true;
+        }
 
-    // print_table(&symbol_table);
+        else if (arg[0] == '-' && arg[1] == 'O' && arg[2] >= '0' && arg[2] <= '3' &&
+                 arg[3] == '\0') {
+            options.opt_level = arg[2] - '0';
+        }
 
-    // printf("%zu\n", symbol_count());
-    if (semantic_error()) {
-        cleanup_ast(&root);
-        assert(root == NULL);
-        assert(ast_node_count() == 0);
-        exit(EXIT_FAILURE);
-    }
+        else if (strcmp(arg, "-o") == 0) {
+            if (i + 1 == argc) {
+                usage(argv[0]);
+            }
+            output.path = argv[++i];
+        }
+
+        else if (strcmp(arg, "-c") == 0) {
+            object = true;
+        }
+
+        else if (strcmp(arg, "-S") == 0) {
+            assembly = true;
+        }
+
+        else if (strcmp(arg, "-emit-llvm") == 0) {
+            emit_llvm = true;
+        }
+
+        else if (strcmp(arg, "-emit-bc") == 0) {
+            emit_bc = true;
+        }
+
+        else if (strcmp(arg, "--run") == 0) {
+            run = true;
+        }
 
-    free(token_buf);
+        else if (strcmp(arg, "-remarks") == 0) {
+            output.remarks = true;
+        }
 
-    /* No semantic error, so translate to LLVM IR */
+        else if (strcmp(arg, "--stats") == 0) {
+            options.stats = true;
+        }
 
-    LLVMModuleRef module = LLVMModuleCreateWithName(file_name);
-    LLVMBuilderRef builder = LLVMCreateBuilder();
+        else if (strcmp(arg, "-ftime-trace") == 0) {
+            options.stats = true;
+            output.time_trace = "pl0c-trace.json";
+        }
 
-    generate_code(root, &symbol_table, &current_level, module, builder);
-    assert(current_level == 0);
+        else if (strncmp(arg, "-ftime-trace=", 13) == 0 && arg[13]) {
+            options.stats = true;
+            output.time_trace = arg + 13;
+        }
 
-    char* error_msg = NULL;
-    LLVMVerifyModule(module, LLVMAbortProcessAction, &error_msg);
+        else if (strcmp(arg, "--cache") == 0) {
+            use_cache = true;
+        }
 
-    // LLVMDumpModule(module);
+        else if (strcmp(arg, "-fincremental") == 0) {
+            incremental = true;
+        }
 
-    cleanup_ast(&root);
-    assert(root == NULL);
-    assert(ast_node_count() == 0);
+        else if (strcmp(arg, "-fssa") == 0) {
+            options.ssa = true;
+        }
 
-    size_t len = strlen(file_name);
-    file_name[len - 3] = 'l';
-    file_name[len - 2] = 'l';
-    file_name[len - 1] = '\0';
+        else if (strcmp(arg, "-fwhole-program") == 0) {
+            options.whole_program = true;
+        }
 
-    LLVMPrintModuleToFile(module, file_name, &error_msg);
+        else if (strcmp(arg, "-fstrict-overflow") == 0) {
+            options.strict_overflow = true;
+        }
 
-    // Cleanup LLVM data structures
-    LLVMDisposeBuilder(builder);
-    LLVMDisposeModule(module);
-    LLVMDisposeMessage(error_msg);
-}
\ No newline at end of file
+        else if (strncmp(arg, "-passes=", 8) == 0) {
+            options.passes = arg + 8;
+        }
+
+        else if (arg[0] == '@') {
+            if (!read_response_file(&files, arg + 1)) {
+                fprintf(stderr, "error: %s not found\n", arg + 1);
+                exit(EXIT_FAILURE);
+            }
+            batch = true;
+        }
+
+        else if (arg[0] == '-' && arg[1] != '\0') {
+            usage(argv[0]);
+        }
+
+        else if (!add_file(&files, arg)) {
+            fprintf(stderr, "error: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (files.count == 0) {
+        fprintf(stderr, "error: no input file\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (output.path && files.count > 1) {
+        fprintf(stderr, "error: -o cannot be used with more than one source\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* the exit status of pl0c is the program's */
+    if (run) {
+        if (files.count > 1 || batch) {
+            fprintf(stderr, "error: --run takes a single source\n");
+            exit(EXIT_FAILURE);
+        }
+        if (options.stats) {
+            fprintf(stderr, "error: --stats and -ftime-trace measure compiling, "
+                            "not --run\n");
+            exit(EXIT_FAILURE);
+        }
+        int status;
+        if (!run_file(files.paths[0], &options, &status)) {
+            status = EXIT_FAILURE;
+        }
+        free_file_list(&files);
+        return status;
+    }
+
+    if (emit_llvm) {
+        output.emit = PL0C_EMIT_LLVM;
+    } else if (emit_bc) {
+        output.emit = PL0C_EMIT_BITCODE;
+    } else if (assembly) {
+        output.emit = PL0C_EMIT_ASM;
+    } else if (object) {
+        output.emit = PL0C_EMIT_OBJECT;
+    } else {
+        output.emit = PL0C_EMIT_OBJECT;
+        output.link = true;
+        output.runtime = find_runtime();
+        const char* cc = getenv("CC");
+        output.linker = cc && *cc ? cc : "cc";
+    }
+
+    cache_t cache;
+    if (use_cache) {
+        output.cache = open_shared_cache(&cache);
+    }
+    /* other kinds of output are one module, cached whole */
+    output.incremental = incremental && output.cache && output.link;
+
+    /*
+     * A single file compiles on the calling thread, with a summary only when
+     * there is optimization time or --stats to report
+     */
+    bool report = batch || files.count > 1 || options.opt_level || options.passes ||
+                  options.stats;
+    size_t failed = compile_batch(&files, &options, &output, jobs, report);
+    free_file_list(&files);
+    if (output.cache) {
+        close_cache(output.cache);
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
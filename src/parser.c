@@ -10,67 +10,127 @@
  * tree.
  */
 
-#include <stdio.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdint.h>
 
 #include "ast.h"
+#include "diag.h"
+#include "intern.h"
 #include "parser.h"
 #include "token.h"
 
-static token_t* token_ptr;
+static void accept(parser_t* p, token_symbol_t s);
 
-static void accept();
+static ast_node_t* parse_block(parser_t* p);
+static ast_node_t* parse_statement_block(parser_t* p);
+static ast_node_t* parse_statement(parser_t* p);
+static ast_node_t* parse_branch(parser_t* p);
+static ast_node_t* parse_condition(parser_t* p);
+static ast_node_t* parse_expression(parser_t* p);
+static ast_node_t* parse_term(parser_t* p);
+static ast_node_t* parse_factor(parser_t* p);
 
-static ast_node_t* parse_block();
-static ast_node_t* parse_statement_block();
-static ast_node_t* parse_statement();
-static ast_node_t* parse_condition();
-static ast_node_t* parse_expression();
-static ast_node_t* parse_term();
-static ast_node_t* parse_factor();
+void init_parser(parser_t* p, token_stream_t* tokens, ast_arena_t* ast_arena,
+                 diag_list_t* diagnostics)
+{
+    p->tokens = tokens;
+    p->ast_arena = ast_arena;
+    p->diagnostics = diagnostics;
+    p->token_pos = 0;
+    p->num_pos = 0;
+    p->ident_pos = 0;
+    p->error = false;
+}
+
+bool syntax_error(const parser_t* p)
+{
+    return p->error;
+}
+
+static token_symbol_t current_symbol(parser_t* p)
+{
+    return p->tokens->symbols[p->token_pos];
+}
+
+/*
+ * Decode the token at index pos. Its NUM value or interned ID, if it has one,
+ * is at side_index in the matching side table.
+ */
+static token_t token_at(parser_t* p, size_t pos, size_t side_index)
+{
+    token_t t;
+    t.text = p->tokens->source + p->tokens->offsets[pos];
+    t.length = p->tokens->lengths[pos];
+    t.symbol = p->tokens->symbols[pos];
+    t.num_value = t.symbol == NUM ? p->tokens->nums[side_index] : 0;
+    t.ident = t.symbol == IDENT ? p->tokens->idents[side_index] : NO_IDENT;
+    return t;
+}
 
-static bool error = false;
+static token_t current_token(parser_t* p)
+{
+    size_t side_index = current_symbol(p) == NUM ? p->num_pos : p->ident_pos;
+    return token_at(p, p->token_pos, side_index);
+}
 
-bool syntax_error()
+/* The token most recently consumed by accept() or advance() */
+static token_t previous_token(parser_t* p)
 {
-    return error;
+    token_symbol_t symbol = p->tokens->symbols[p->token_pos - 1];
+    size_t side_index = symbol == NUM ? p->num_pos : p->ident_pos;
+    return token_at(p, p->token_pos - 1, side_index - 1);
 }
 
-void set_token_ptr(token_t** t)
+static void advance(parser_t* p)
 {
-    token_ptr = *t;
+    if (p->tokens->symbols[p->token_pos] == NUM) {
+        p->num_pos++;
+    } else if (p->tokens->symbols[p->token_pos] == IDENT) {
+        p->ident_pos++;
+    }
+    p->token_pos++;
 }
 
-ast_node_t* parse()
+ast_node_t* parse(parser_t* p)
 {
-    ast_node_t* root = parse_block();
+    ast_node_t* root = parse_block(p);
     root->label = AST_ROOT;
-    accept(LIST_END);
+    accept(p, LIST_END);
     return root;
 }
 
-static void accept(token_symbol_t s)
+static void accept(parser_t* p, token_symbol_t s)
 {
-    if (token_ptr->symbol == s) {
-        // print_token(*token_ptr);
-        token_ptr++;
+    if (current_symbol(p) == s) {
+        advance(p);
     }
 
     else {
-        error = true;
-        printf("error: expected symbol ");
-        print_symbol(s);
-        printf(" but found ");
-        print_symbol(token_ptr->symbol);
-        printf("\n");
-        print_token(*token_ptr);
-        token_ptr++;
+        token_t found = current_token(p);
+        p->error = true;
+        /* the lexer leaves digits that don't fit in an int64_t as ERROR */
+        if (found.symbol == ERROR && found.length &&
+            isdigit((unsigned char)found.text[0])) {
+            report(p->diagnostics,
+                   "error: integer literal '%.*s' out of range, the largest is %"
+                   PRId64, (int)found.length, found.text, INT64_MAX);
+        } else {
+            report(p->diagnostics, "error: expected symbol %s but found %s '%.*s'",
+                   symbol_name(s), symbol_name(found.symbol), (int)found.length,
+                   found.text);
+        }
+        /* never run past the end of the stream */
+        if (current_symbol(p) != LIST_END) {
+            advance(p);
+        }
     }
 }
 
-static ast_node_t* parse_block()
+static ast_node_t* parse_block(parser_t* p)
 {
-    token_t block_token = { "BEGIN", 0, BEGIN };
-    ast_node_t* main_root = new_ast_node(block_token);
+    token_t block_token = { "BEGIN", 5, NO_IDENT, 0, BEGIN };
+    ast_node_t* main_root = new_ast_node(p->ast_arena, block_token);
     main_root->label = AST_BLOCK;
 
     ast_node_t* const_decl = NULL;
@@ -79,228 +139,245 @@ static ast_node_t* parse_block()
     ast_node_t* new_child = NULL;
     ast_node_t* new_child_num = NULL;
 
-    if (token_ptr->symbol == CONST) {
-        accept(CONST);
-        const_decl = new_ast_node(*(token_ptr - 1));
-        accept(IDENT);
-        new_child = new_ast_node(*(token_ptr - 1));
+    if (current_symbol(p) == CONST) {
+        accept(p, CONST);
+        const_decl = new_ast_node(p->ast_arena, previous_token(p));
+        accept(p, IDENT);
+        new_child = new_ast_node(p->ast_arena, previous_token(p));
         append_child(const_decl, new_child);
-        accept(ASSIGN);
-        accept(NUM);
-        new_child_num = new_ast_node(*(token_ptr - 1));
+        accept(p, ASSIGN);
+        accept(p, NUM);
+        new_child_num = new_ast_node(p->ast_arena, previous_token(p));
         append_child(new_child, new_child_num);
 
-        while (token_ptr->symbol == COMMA) {
-            accept(COMMA);
-            accept(IDENT);
-            new_child = new_ast_node(*(token_ptr - 1));
+        while (current_symbol(p) == COMMA) {
+            accept(p, COMMA);
+            accept(p, IDENT);
+            new_child = new_ast_node(p->ast_arena, previous_token(p));
             append_child(const_decl, new_child);
-            accept(ASSIGN);
-            accept(NUM);
-            new_child_num = new_ast_node(*(token_ptr - 1));
+            accept(p, ASSIGN);
+            accept(p, NUM);
+            new_child_num = new_ast_node(p->ast_arena, previous_token(p));
             append_child(new_child, new_child_num);
         }
-        accept(SEMICOLON);
+        accept(p, SEMICOLON);
         append_child(main_root, const_decl);
     }
 
-    if (token_ptr->symbol == VAR) {
-        accept(VAR);
-        var_decl = new_ast_node(*(token_ptr - 1));
-        accept(IDENT);
-        new_child = new_ast_node(*(token_ptr - 1));
+    if (current_symbol(p) == VAR) {
+        accept(p, VAR);
+        var_decl = new_ast_node(p->ast_arena, previous_token(p));
+        accept(p, IDENT);
+        new_child = new_ast_node(p->ast_arena, previous_token(p));
         append_child(var_decl, new_child);
-        while (token_ptr->symbol == COMMA) {
-            accept(COMMA);
-            accept(IDENT);
-            new_child = new_ast_node(*(token_ptr - 1));
+        while (current_symbol(p) == COMMA) {
+            accept(p, COMMA);
+            accept(p, IDENT);
+            new_child = new_ast_node(p->ast_arena, previous_token(p));
             append_child(var_decl, new_child);
         }
-        accept(SEMICOLON);
+        accept(p, SEMICOLON);
         append_child(main_root, var_decl);
     }
 
-    while (token_ptr->symbol == PROCEDURE) {
-        accept(PROCEDURE);
-        proc_decl = new_ast_node(*(token_ptr - 1));
-        accept(IDENT);
-        new_child = new_ast_node(*(token_ptr - 1));
+    while (current_symbol(p) == PROCEDURE) {
+        accept(p, PROCEDURE);
+        proc_decl = new_ast_node(p->ast_arena, previous_token(p));
+        accept(p, IDENT);
+        new_child = new_ast_node(p->ast_arena, previous_token(p));
         append_child(proc_decl, new_child);
-        accept(COLON);
-        new_child = parse_block();
+        accept(p, COLON);
+        new_child = parse_block(p);
         append_child(proc_decl, new_child);
         append_child(main_root, proc_decl);
     }
 
-    new_child = parse_statement_block();
+    new_child = parse_statement_block(p);
     append_child(main_root, new_child);
     return main_root;
 }
 
-static ast_node_t* parse_statement_block()
+static ast_node_t* parse_statement_block(parser_t* p)
 {
     ast_node_t* main_root = NULL;
     ast_node_t* new_child = NULL;
 
-    if (token_ptr->symbol == BEGIN) {
-        accept(BEGIN);
-        main_root = new_ast_node(*(token_ptr - 1));
-        while (token_ptr->symbol == IDENT || token_ptr->symbol == CALL ||
-               token_ptr->symbol == IF || token_ptr->symbol == WHILE ||
-               token_ptr->symbol == PRINT || token_ptr->symbol == SCAN) {
-            new_child = parse_statement();
+    if (current_symbol(p) == BEGIN) {
+        accept(p, BEGIN);
+        main_root = new_ast_node(p->ast_arena, previous_token(p));
+        while (current_symbol(p) == IDENT || current_symbol(p) == CALL ||
+               current_symbol(p) == IF || current_symbol(p) == WHILE ||
+               current_symbol(p) == PRINT || current_symbol(p) == SCAN) {
+            new_child = parse_statement(p);
             append_child(main_root, new_child);
         }
-        accept(END);
+        accept(p, END);
     }
 
     else {
-        main_root = parse_statement();
+        main_root = parse_statement(p);
     }
 
     return main_root;
 }
 
-static ast_node_t* parse_statement()
+/*
+ * The statement of an IF, ELSE or WHILE branch. A branch may be empty; it then
+ * gets an empty block, so that an ELSE after an empty IF branch stays second.
+ */
+static ast_node_t* parse_branch(parser_t* p)
+{
+    ast_node_t* main_root = parse_statement_block(p);
+    if (!main_root) {
+        token_t empty_block = { "BEGIN", 5, NO_IDENT, 0, BEGIN };
+        main_root = new_ast_node(p->ast_arena, empty_block);
+    }
+    return main_root;
+}
+
+static ast_node_t* parse_statement(parser_t* p)
 {
     ast_node_t* main_root = NULL;
     ast_node_t* operand = NULL;
     ast_node_t* new_child = NULL; /* Using this for better code readability */
 
-    if (token_ptr->symbol == IDENT) {
-        accept(IDENT);
-        operand = new_ast_node(*(token_ptr - 1));
-        accept(ASSIGN);
-        main_root = new_ast_node(*(token_ptr - 1));
+    if (current_symbol(p) == IDENT) {
+        accept(p, IDENT);
+        operand = new_ast_node(p->ast_arena, previous_token(p));
+        accept(p, ASSIGN);
+        main_root = new_ast_node(p->ast_arena, previous_token(p));
         append_child(main_root, operand);
-        operand = parse_expression();
+        operand = parse_expression(p);
         append_child(main_root, operand);
-        accept(SEMICOLON);
+        accept(p, SEMICOLON);
     }
 
-    else if (token_ptr->symbol == CALL) {
-        accept(CALL);
-        main_root = new_ast_node(*(token_ptr - 1));
-        accept(IDENT);
-        operand = new_ast_node(*(token_ptr - 1));
+    else if (current_symbol(p) == CALL) {
+        accept(p, CALL);
+        main_root = new_ast_node(p->ast_arena, previous_token(p));
+        accept(p, IDENT);
+        operand = new_ast_node(p->ast_arena, previous_token(p));
         append_child(main_root, operand);
-        accept(SEMICOLON);
+        accept(p, SEMICOLON);
     }
 
-    else if (token_ptr->symbol == IF) {
-        accept(IF);
-        main_root = new_ast_node(*(token_ptr - 1));
-        new_child = parse_condition();
+    else if (current_symbol(p) == IF) {
+        accept(p, IF);
+        main_root = new_ast_node(p->ast_arena, previous_token(p));
+        new_child = parse_condition(p);
         append_child(main_root, new_child);
-        accept(COLON);
-        new_child = parse_statement_block();
+        accept(p, COLON);
+        new_child = parse_branch(p);
         append_child(main_root, new_child);
-        if (token_ptr->symbol == ELSE) {
-            accept(ELSE);
-            accept(COLON);
-            new_child = parse_statement_block();
+        if (current_symbol(p) == ELSE) {
+            accept(p, ELSE);
+            accept(p, COLON);
+            new_child = parse_branch(p);
             append_child(main_root, new_child);
         }
     }
 
-    else if (token_ptr->symbol == WHILE) {
-        accept(WHILE);
-        main_root = new_ast_node(*(token_ptr - 1));
-        new_child = parse_condition();
+    else if (current_symbol(p) == WHILE) {
+        accept(p, WHILE);
+        main_root = new_ast_node(p->ast_arena, previous_token(p));
+        new_child = parse_condition(p);
         append_child(main_root, new_child);
-        accept(COLON);
-        new_child = parse_statement_block();
+        accept(p, COLON);
+        new_child = parse_branch(p);
         append_child(main_root, new_child);
     }
 
-    else if (token_ptr->symbol == PRINT) {
-        accept(PRINT);
-        main_root = new_ast_node(*(token_ptr - 1));
-        if (token_ptr->symbol == IDENT) {
-            accept(IDENT);
-            operand = new_ast_node(*(token_ptr - 1));
+    else if (current_symbol(p) == PRINT) {
+        accept(p, PRINT);
+        main_root = new_ast_node(p->ast_arena, previous_token(p));
+        if (current_symbol(p) == IDENT) {
+            accept(p, IDENT);
+            operand = new_ast_node(p->ast_arena, previous_token(p));
             append_child(main_root, operand);
         }
 
         else {
-            accept(NUM);
-            operand = new_ast_node(*(token_ptr - 1));
+            accept(p, NUM);
+            operand = new_ast_node(p->ast_arena, previous_token(p));
             append_child(main_root, operand);
         }
-        accept(SEMICOLON);
+        accept(p, SEMICOLON);
     }
 
-    else if (token_ptr->symbol == SCAN) {
-        accept(SCAN);
-        main_root = new_ast_node(*(token_ptr - 1));
-        accept(IDENT);
-        operand = new_ast_node(*(token_ptr - 1));
+    else if (current_symbol(p) == SCAN) {
+        accept(p, SCAN);
+        main_root = new_ast_node(p->ast_arena, previous_token(p));
+        accept(p, IDENT);
+        operand = new_ast_node(p->ast_arena, previous_token(p));
         append_child(main_root, operand);
-        accept(SEMICOLON);
+        accept(p, SEMICOLON);
     }
 
     return main_root;
 }
 
-static ast_node_t* parse_condition()
+static ast_node_t* parse_condition(parser_t* p)
 {
     ast_node_t* main_root = NULL;
     ast_node_t* operand = NULL;
-    if (token_ptr->symbol == ODD) {
-        accept(ODD);
-        main_root = new_ast_node(*(token_ptr - 1));
-        operand = parse_expression();
+    if (current_symbol(p) == ODD) {
+        accept(p, ODD);
+        main_root = new_ast_node(p->ast_arena, previous_token(p));
+        operand = parse_expression(p);
         append_child(main_root, operand);
     }
 
     else {
-        operand = parse_expression();
+        operand = parse_expression(p);
 
-        if (token_ptr->symbol == GTE || token_ptr->symbol == LTE ||
-            token_ptr->symbol == GREATER || token_ptr->symbol == LESSER ||
-            token_ptr->symbol == NOTEQUAL || token_ptr->symbol == EQUAL) {
-            main_root = new_ast_node(*token_ptr);
-            token_ptr++;
+        if (current_symbol(p) == GTE || current_symbol(p) == LTE ||
+            current_symbol(p) == GREATER || current_symbol(p) == LESSER ||
+            current_symbol(p) == NOTEQUAL || current_symbol(p) == EQUAL) {
+            main_root = new_ast_node(p->ast_arena, current_token(p));
+            advance(p);
             append_child(main_root, operand);
-            operand = parse_expression();
+            operand = parse_expression(p);
             append_child(main_root, operand);
         }
 
         else {
-            printf("error: inavid conditional operator\n");
-            token_ptr++;
+            report(p->diagnostics, "error: invalid conditional operator");
+            p->error = true;
+            if (current_symbol(p) != LIST_END) {
+                advance(p);
+            }
         }
     }
 
     return main_root;
 }
 
-static ast_node_t* parse_expression()
+static ast_node_t* parse_expression(parser_t* p)
 {
     ast_node_t* operand = NULL;
     ast_node_t* tmp_root = NULL;
     ast_node_t* main_root = NULL;
     ast_node_t* current_root = NULL;
 
-    if (token_ptr->symbol == PLUS) {
-        accept(PLUS);
-        current_root = new_ast_node(*(token_ptr - 1));
+    if (current_symbol(p) == PLUS) {
+        accept(p, PLUS);
+        current_root = new_ast_node(p->ast_arena, previous_token(p));
         main_root = current_root;
     }
 
-    else if (token_ptr->symbol == MINUS) {
-        accept(MINUS);
-        current_root = new_ast_node(*(token_ptr - 1));
+    else if (current_symbol(p) == MINUS) {
+        accept(p, MINUS);
+        current_root = new_ast_node(p->ast_arena, previous_token(p));
         main_root = current_root;
     }
 
-    operand = parse_term();
+    operand = parse_term(p);
 
-    while (token_ptr->symbol == PLUS || token_ptr->symbol == MINUS) {
-        if (token_ptr->symbol == PLUS) {
-            accept(PLUS);
+    while (current_symbol(p) == PLUS || current_symbol(p) == MINUS) {
+        if (current_symbol(p) == PLUS) {
+            accept(p, PLUS);
             tmp_root = current_root;
-            current_root = new_ast_node(*(token_ptr - 1));
+            current_root = new_ast_node(p->ast_arena, previous_token(p));
             append_child(current_root, operand);
             if (tmp_root) {
                 append_child(tmp_root, current_root);
@@ -308,10 +385,10 @@ static ast_node_t* parse_expression()
             }
         }
 
-        else if (token_ptr->symbol == MINUS) {
-            accept(MINUS);
+        else if (current_symbol(p) == MINUS) {
+            accept(p, MINUS);
             tmp_root = current_root;
-            current_root = new_ast_node(*(token_ptr - 1));
+            current_root = new_ast_node(p->ast_arena, previous_token(p));
             append_child(current_root, operand);
             if (tmp_root) {
                 append_child(tmp_root, current_root);
@@ -319,8 +396,8 @@ static ast_node_t* parse_expression()
             }
         }
 
-        operand = parse_term();
-        if (token_ptr->symbol != PLUS && token_ptr->symbol != MINUS) {
+        operand = parse_term(p);
+        if (current_symbol(p) != PLUS && current_symbol(p) != MINUS) {
             /* Next symbol is not an operation, so append the operand to the
              * current operation. The loop will break after this
              */
@@ -332,18 +409,18 @@ static ast_node_t* parse_expression()
     return (main_root) ? main_root : operand;
 }
 
-static ast_node_t* parse_term()
+static ast_node_t* parse_term(parser_t* p)
 {
-    ast_node_t* operand = parse_factor();
+    ast_node_t* operand = parse_factor(p);
     ast_node_t* tmp_root = NULL;
     ast_node_t* main_root = NULL;
     ast_node_t* current_root = NULL;
 
-    while (token_ptr->symbol == TIMES || token_ptr->symbol == SLASH) {
-        if (token_ptr->symbol == TIMES) {
-            accept(TIMES);
+    while (current_symbol(p) == TIMES || current_symbol(p) == SLASH) {
+        if (current_symbol(p) == TIMES) {
+            accept(p, TIMES);
             tmp_root = current_root;
-            current_root = new_ast_node(*(token_ptr - 1));
+            current_root = new_ast_node(p->ast_arena, previous_token(p));
             append_child(current_root, operand);
             if (tmp_root) {
                 append_child(tmp_root, current_root);
@@ -351,10 +428,10 @@ static ast_node_t* parse_term()
             }
         }
 
-        else if (token_ptr->symbol == SLASH) {
-            accept(SLASH);
+        else if (current_symbol(p) == SLASH) {
+            accept(p, SLASH);
             tmp_root = current_root;
-            current_root = new_ast_node(*(token_ptr - 1));
+            current_root = new_ast_node(p->ast_arena, previous_token(p));
             append_child(current_root, operand);
             if (tmp_root) {
                 append_child(tmp_root, current_root);
@@ -362,8 +439,8 @@ static ast_node_t* parse_term()
             }
         }
 
-        operand = parse_factor();
-        if (token_ptr->symbol != TIMES && token_ptr->symbol != SLASH) {
+        operand = parse_factor(p);
+        if (current_symbol(p) != TIMES && current_symbol(p) != SLASH) {
             /* Next symbol is not an operation, so append the operand to the
              * current operation. The loop will break after this
              */
@@ -375,22 +452,22 @@ static ast_node_t* parse_term()
     return (main_root) ? main_root : operand;
 }
 
-static ast_node_t* parse_factor()
+static ast_node_t* parse_factor(parser_t* p)
 {
-    if (token_ptr->symbol == NUM) {
-        accept(NUM);
-        return new_ast_node(*(token_ptr - 1));
+    if (current_symbol(p) == NUM) {
+        accept(p, NUM);
+        return new_ast_node(p->ast_arena, previous_token(p));
     }
 
-    else if (token_ptr->symbol == LPAREN) {
-        accept(LPAREN);
-        ast_node_t* main_root = parse_expression();
-        accept(RPAREN);
+    else if (current_symbol(p) == LPAREN) {
+        accept(p, LPAREN);
+        ast_node_t* main_root = parse_expression(p);
+        accept(p, RPAREN);
         return main_root;
     }
 
     else {
-        accept(IDENT);
-        return new_ast_node(*(token_ptr - 1));
+        accept(p, IDENT);
+        return new_ast_node(p->ast_arena, previous_token(p));
     }
 }
\ No newline at end of file
@@ -10,12 +10,25 @@
 #include <stdbool.h>
 
 #include "ast.h"
+#include "diag.h"
 #include "token.h"
 
-void set_token_ptr(token_t** t);
+/* Parser state, one per compilation */
+typedef struct {
+    token_stream_t* tokens;
+    ast_arena_t* ast_arena;
+    diag_list_t* diagnostics;
+    size_t token_pos;
+    size_t num_pos;   // index into tokens->nums of the next NUM token
+    size_t ident_pos; // index into tokens->idents of the next IDENT token
+    bool error;
+} parser_t;
 
-ast_node_t* parse();
+void init_parser(parser_t* p, token_stream_t* tokens, ast_arena_t* ast_arena,
+                 diag_list_t* diagnostics);
 
-bool syntax_error();
+ast_node_t* parse(parser_t* p);
+
+bool syntax_error(const parser_t* p);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,811 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+/*
+ * Library entry points. Everything a compilation touches is reached from the
+ * context or lives on the stack of the call, so there is no global state
+ * besides the one time registration of the native target.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <llvm-c/Analysis.h>
+#include <llvm-c/BitReader.h>
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Linker.h>
+#include <llvm-c/Orc.h>
+#include <llvm-c/Target.h>
+#include <llvm-c/TargetMachine.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+#include <llvm/Config/llvm-config.h>
+
+#include "ast.h"
+#include "callgraph.h"
+#include "codegen.h"
+#include "diag.h"
+#include "fold.h"
+#include "hash.h"
+#include "intern.h"
+#include "lexer.h"
+#include "parser.h"
+#include "pl0c.h"
+#include "symtab.h"
+#include "token.h"
+#include "trace.h"
+#include "unit.h"
+
+struct pl0c_context {
+    LLVMOrcThreadSafeContextRef jit_context; // owns llvm, shared with the JIT
+    LLVMContextRef llvm;
+    intern_table_t names;
+    diag_list_t diagnostics;
+    diag_list_t remarks;
+    pl0c_options_t options;
+    pl0c_stats_t stats;
+    trace_t trace;
+};
+
+static pthread_once_t native_target_once = PTHREAD_ONCE_INIT;
+
+static void init_native_target()
+{
+    LLVMInitializeNativeTarget();
+    LLVMInitializeNativeAsmPrinter();
+}
+
+pl0c_context_t* pl0c_create_context()
+{
+    pl0c_context_t* ctx = malloc(sizeof(pl0c_context_t));
+    if (!ctx)
+        return NULL;
+    ctx->jit_context = LLVMOrcCreateNewThreadSafeContext();
+    ctx->llvm = LLVMOrcThreadSafeContextGetContext(ctx->jit_context);
+    init_intern_table(&ctx->names);
+    init_diagnostics(&ctx->diagnostics);
+    init_diagnostics(&ctx->remarks);
+    memset(&ctx->options, 0, sizeof(ctx->options));
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    init_trace(&ctx->trace);
+    return ctx;
+}
+
+void pl0c_destroy_context(pl0c_context_t* ctx)
+{
+    if (!ctx)
+        return;
+    free_interned(&ctx->names);
+    free_diagnostics(&ctx->diagnostics);
+    free_diagnostics(&ctx->remarks);
+    free_trace(&ctx->trace);
+    LLVMOrcDisposeThreadSafeContext(ctx->jit_context);
+    free(ctx);
+}
+
+LLVMContextRef pl0c_llvm_context(pl0c_context_t* ctx)
+{
+    return ctx->llvm;
+}
+
+void pl0c_set_options(pl0c_context_t* ctx, const pl0c_options_t* options)
+{
+    ctx->options = *options;
+    if (ctx->options.opt_level < 0)
+        ctx->options.opt_level = 0;
+    if (ctx->options.opt_level > 3)
+        ctx->options.opt_level = 3;
+    ctx->trace.enabled = options->stats;
+}
+
+const pl0c_stats_t* pl0c_stats(const pl0c_context_t* ctx)
+{
+    return &ctx->stats;
+}
+
+/* Add the time since start to the phase's seconds, and trace it */
+static void end_phase(pl0c_context_t* ctx, const char* name, double start,
+                      double* seconds)
+{
+    double end = trace_clock();
+    *seconds += end - start;
+    trace_event(&ctx->trace, name, NULL, start, end);
+}
+
+static size_t count_instructions(LLVMModuleRef module)
+{
+    size_t count = 0;
+    for (LLVMValueRef f = LLVMGetFirstFunction(module); f;
+         f = LLVMGetNextFunction(f)) {
+        for (LLVMBasicBlockRef b = LLVMGetFirstBasicBlock(f); b;
+             b = LLVMGetNextBasicBlock(b)) {
+            for (LLVMValueRef i = LLVMGetFirstInstruction(b); i;
+                 i = LLVMGetNextInstruction(i)) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+/*
+ * Target machine for the host, at the code generation level matching the
+ * optimization level. module is retargeted to it so that passes and the
+ * backend agree on the data layout.
+ */
+static LLVMTargetMachineRef host_machine(pl0c_context_t* ctx, LLVMModuleRef module)
+{
+    static const LLVMCodeGenOptLevel codegen_levels[] = {
+        LLVMCodeGenLevelNone,
+        LLVMCodeGenLevelLess,
+        LLVMCodeGenLevelDefault,
+        LLVMCodeGenLevelAggressive,
+    };
+
+    pthread_once(&native_target_once, init_native_target);
+
+    char* error_msg = NULL;
+    char* triple = LLVMGetDefaultTargetTriple();
+    LLVMTargetRef target;
+    if (LLVMGetTargetFromTriple(triple, &target, &error_msg)) {
+        report(&ctx->diagnostics, "error: %s", error_msg);
+        LLVMDisposeMessage(error_msg);
+        LLVMDisposeMessage(triple);
+        return NULL;
+    }
+
+    char* cpu = LLVMGetHostCPUName();
+    char* features = LLVMGetHostCPUFeatures();
+    LLVMTargetMachineRef machine = LLVMCreateTargetMachine(
+        target, triple, cpu, features, codegen_levels[ctx->options.opt_level],
+        LLVMRelocPIC, LLVMCodeModelDefault);
+    LLVMDisposeMessage(cpu);
+    LLVMDisposeMessage(features);
+
+    LLVMSetTarget(module, triple);
+    LLVMTargetDataRef layout = LLVMCreateTargetDataLayout(machine);
+    LLVMSetModuleDataLayout(module, layout);
+    LLVMDisposeTargetData(layout);
+    LLVMDisposeMessage(triple);
+    return machine;
+}
+
+/* print64 and scan64 compiled to bitcode, from runtime_bc.c */
+extern const unsigned char pl0rt_bc[];
+extern const unsigned int pl0rt_bc_len;
+
+static const char* const runtime_functions[] = { "print64", "scan64" };
+
+/* Without a handler LLVM prints bitcode errors and exits */
+static void bitcode_error(LLVMDiagnosticInfoRef info, void* handler_context)
+{
+    pl0c_context_t* ctx = handler_context;
+    if (LLVMGetDiagInfoSeverity(info) != LLVMDSError)
+        return;
+    char* message = LLVMGetDiagInfoDescription(info);
+    report(&ctx->diagnostics, "error: invalid bitcode: %s", message);
+    LLVMDisposeMessage(message);
+}
+
+/*
+ * Link the bitcode of print64 and scan64 into module if it calls them, so
+ * they can be inlined. They become internal to module; the buffers and slow
+ * paths they use stay external, in libpl0rt.
+ */
+static bool link_runtime(pl0c_context_t* ctx, LLVMModuleRef module)
+{
+    size_t count = sizeof(runtime_functions) / sizeof(runtime_functions[0]);
+    bool used = false;
+    for (size_t i = 0; i < count; i++) {
+        LLVMValueRef function = LLVMGetNamedFunction(module, runtime_functions[i]);
+        used |= function && LLVMIsDeclaration(function);
+    }
+    if (!used)
+        return true;
+
+    LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRange(
+        (const char*)pl0rt_bc, pl0rt_bc_len, "pl0rt.bc", false);
+    LLVMModuleRef runtime = NULL;
+    LLVMContextSetDiagnosticHandler(ctx->llvm, bitcode_error, ctx);
+    bool failed = LLVMParseBitcodeInContext2(ctx->llvm, buffer, &runtime);
+    LLVMDisposeMemoryBuffer(buffer);
+    if (!failed) {
+        /* both are for the host; this keeps the linker from warning */
+        LLVMSetTarget(runtime, LLVMGetTarget(module));
+        LLVMSetDataLayout(runtime, LLVMGetDataLayoutStr(module));
+        failed = LLVMLinkModules2(module, runtime); // consumes runtime
+    }
+    LLVMContextSetDiagnosticHandler(ctx->llvm, NULL, NULL);
+    if (failed)
+        return false;
+
+    for (size_t i = 0; i < count; i++) {
+        LLVMValueRef function = LLVMGetNamedFunction(module, runtime_functions[i]);
+        if (function && !LLVMIsDeclaration(function))
+            LLVMSetLinkage(function, LLVMInternalLinkage);
+    }
+    return true;
+}
+
+/*
+ * Run the pass pipeline asked for by the options, default<On> for -On, after
+ * linking in the runtime. -O0 without a custom pipeline leaves the module
+ * exactly as generated.
+ */
+static bool optimize(pl0c_context_t* ctx, LLVMModuleRef module)
+{
+    int level = ctx->options.opt_level;
+    const char* passes = ctx->options.passes;
+    char pipeline[16];
+
+    if (!passes) {
+        if (level == 0)
+            return true;
+        snprintf(pipeline, sizeof(pipeline), "default<O%d>", level);
+        passes = pipeline;
+    }
+
+    double start = trace_clock();
+
+    LLVMTargetMachineRef machine = host_machine(ctx, module);
+    if (!machine)
+        return false;
+    if (!link_runtime(ctx, module)) {
+        LLVMDisposeTargetMachine(machine);
+        return false;
+    }
+
+    /* vectorizers are on from -O2, as in clang */
+    LLVMPassBuilderOptionsRef options = LLVMCreatePassBuilderOptions();
+    LLVMPassBuilderOptionsSetLoopVectorization(options, level >= 2);
+    LLVMPassBuilderOptionsSetSLPVectorization(options, level >= 2);
+
+    LLVMErrorRef error = LLVMRunPasses(module, passes, machine, options);
+    LLVMDisposePassBuilderOptions(options);
+    LLVMDisposeTargetMachine(machine);
+
+    end_phase(ctx, "optimize", start, &ctx->stats.optimize_seconds);
+
+    if (error) {
+        char* message = LLVMGetErrorMessage(error);
+        report(&ctx->diagnostics, "error: %s", message);
+        LLVMDisposeErrorMessage(message);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Procedures main can't reach are removed before the semantic checks, so
+ * they cost nothing past parsing. Each is listed in the remarks.
+ */
+static bool drop_uncalled(pl0c_context_t* ctx, flat_ast_t* ast)
+{
+    call_graph_t graph;
+    if (!build_call_graph(ast, &ctx->names, &graph))
+        return false;
+
+    bool ok = true;
+    ctx->stats.procedures_dropped = unreachable_count(&graph);
+    if (ctx->stats.procedures_dropped) {
+        for (size_t i = 0; i < graph.proc_count; i++) {
+            if (!graph.procs[i].reachable) {
+                report(&ctx->remarks, "remark: procedure %s is never called",
+                       interned_string(&ctx->names, graph.procs[i].name));
+            }
+        }
+
+        flat_ast_t pruned;
+        ok = prune_unreachable(ast, &graph, &pruned);
+        if (ok) {
+            free_flat_ast(ast);
+            *ast = pruned;
+        }
+    }
+
+    free_call_graph(&graph);
+    return ok;
+}
+
+/* what tells where module came from, for the error message */
+static bool verify(pl0c_context_t* ctx, LLVMModuleRef module, const char* what)
+{
+    double start = trace_clock();
+    char* error_msg = NULL;
+    bool broken = LLVMVerifyModule(module, LLVMReturnStatusAction, &error_msg);
+    end_phase(ctx, "verify", start, &ctx->stats.verify_seconds);
+    if (broken)
+        report(&ctx->diagnostics, "error: invalid module %s\n%s", what, error_msg);
+    LLVMDisposeMessage(error_msg);
+    return !broken;
+}
+
+/*
+ * Everything before code generation: scan, parse, drop procedures never
+ * called, check and fold constants. On success the caller owns ast, symtab
+ * and calls, the call graph of ast.
+ */
+static bool front_end(pl0c_context_t* ctx, const char* name, const char* text,
+                      size_t len, flat_ast_t* ast, symtab_t* symtab,
+                      call_graph_t* calls)
+{
+    /* names and errors of an earlier compilation are not needed any more */
+    clear_diagnostics(&ctx->diagnostics);
+    clear_diagnostics(&ctx->remarks);
+    free_interned(&ctx->names);
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    clear_trace(&ctx->trace);
+
+    double start = trace_clock();
+    token_stream_t tokens;
+    if (!scan_buffer(text, len, &tokens, &ctx->names)) {
+        report(&ctx->diagnostics, "error: %s could not be scanned", name);
+        return false;
+    }
+    end_phase(ctx, "scan", start, &ctx->stats.scan_seconds);
+    ctx->stats.tokens = tokens.count;
+
+    start = trace_clock();
+    ast_arena_t ast_arena;
+    init_ast_arena(&ast_arena);
+
+    parser_t parser;
+    init_parser(&parser, &tokens, &ast_arena, &ctx->diagnostics);
+    ast_node_t* root = parse(&parser);
+
+    /* The AST holds its own copies of names and values */
+    free_token_stream(&tokens);
+
+    if (syntax_error(&parser)) {
+        release_ast(&ast_arena, &root);
+        return false;
+    }
+    ctx->stats.ast_nodes = ast_arena.node_count;
+
+    /* Later passes walk the flattened copy, so the tree can go right away */
+    flat_ast_t flat_ast;
+    bool flattened = flatten_ast(root, ast_arena.node_count, &flat_ast);
+    release_ast(&ast_arena, &root);
+    end_phase(ctx, "parse", start, &ctx->stats.parse_seconds);
+    if (!flattened) {
+        report(&ctx->diagnostics, "error: out of memory");
+        return false;
+    }
+
+    start = trace_clock();
+    bool pruned = drop_uncalled(ctx, &flat_ast);
+    end_phase(ctx, "drop_uncalled", start, &ctx->stats.prune_seconds);
+    if (!pruned) {
+        free_flat_ast(&flat_ast);
+        report(&ctx->diagnostics, "error: out of memory");
+        return false;
+    }
+
+    start = trace_clock();
+    init_symtab(symtab, &ctx->names, &ctx->diagnostics);
+    run_semantic_checks(&flat_ast, 0, symtab);
+    end_phase(ctx, "run_semantic_checks", start, &ctx->stats.check_seconds);
+    ctx->stats.symbols = declared_symbols(symtab);
+
+    if (semantic_error(symtab)) {
+        free_symtab(symtab);
+        free_flat_ast(&flat_ast);
+        return false;
+    }
+
+    /* CONSTs and arithmetic on them are resolved before code generation */
+    start = trace_clock();
+    bool folded = fold_constants(&flat_ast, symtab, ast);
+    free_flat_ast(&flat_ast);
+
+    /* folding may have removed calls, so the graph is built again */
+    bool built = folded && build_call_graph(ast, &ctx->names, calls);
+    end_phase(ctx, "fold_constants", start, &ctx->stats.fold_seconds);
+    if (!built) {
+        if (folded)
+            free_flat_ast(ast);
+        free_symtab(symtab);
+        report(&ctx->diagnostics, "error: out of memory");
+        return false;
+    }
+    return true;
+}
+
+/* Generate unit of ast into a new module, verified and optimized */
+static LLVMModuleRef back_end(pl0c_context_t* ctx, const char* name,
+                              const flat_ast_t* ast, symtab_t* symtab,
+                              const call_graph_t* calls, size_t unit)
+{
+    LLVMModuleRef module = LLVMModuleCreateWithNameInContext(name, ctx->llvm);
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(ctx->llvm);
+
+    /* units are linked with each other, so nothing in them can be internal */
+    codegen_options_t codegen_options = {
+        .ssa = ctx->options.ssa,
+        .whole_program = ctx->options.whole_program && unit == CODEGEN_PROGRAM,
+        .strict_overflow = ctx->options.strict_overflow,
+        .calls = calls,
+        .unit = unit,
+        .trace = ctx->trace.enabled ? &ctx->trace : NULL,
+    };
+    double start = trace_clock();
+    generate_code(ast, symtab, module, builder, &codegen_options);
+    LLVMDisposeBuilder(builder);
+    end_phase(ctx, "generate_code", start, &ctx->stats.generate_seconds);
+
+    if (ctx->options.stats)
+        ctx->stats.instructions += count_instructions(module);
+
+    if (!verify(ctx, module, "generated") || !optimize(ctx, module)) {
+        LLVMDisposeModule(module);
+        return NULL;
+    }
+
+    if (ctx->options.stats)
+        ctx->stats.optimized_instructions += count_instructions(module);
+
+    return module;
+}
+
+LLVMModuleRef pl0c_compile_module(pl0c_context_t* ctx, const char* name,
+                                  const char* text, size_t len)
+{
+    flat_ast_t ast;
+    symtab_t symtab;
+    call_graph_t calls;
+    if (!front_end(ctx, name, text, len, &ast, &symtab, &calls))
+        return NULL;
+
+    /* No semantic error, so translate to LLVM IR */
+    LLVMModuleRef module =
+        back_end(ctx, name, &ast, &symtab, &calls, CODEGEN_PROGRAM);
+
+    free_call_graph(&calls);
+    free_symtab(&symtab);
+    free_flat_ast(&ast);
+    return module;
+}
+
+LLVMModuleRef pl0c_load_bitcode(pl0c_context_t* ctx, const char* name,
+                                const char* data, size_t len)
+{
+    clear_diagnostics(&ctx->diagnostics);
+    clear_diagnostics(&ctx->remarks);
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    clear_trace(&ctx->trace);
+
+    /* the buffer only borrows data */
+    LLVMMemoryBufferRef buffer =
+        LLVMCreateMemoryBufferWithMemoryRange(data, len, name, false);
+    LLVMModuleRef module = NULL;
+    LLVMContextSetDiagnosticHandler(ctx->llvm, bitcode_error, ctx);
+    bool failed = LLVMParseBitcodeInContext2(ctx->llvm, buffer, &module);
+    LLVMContextSetDiagnosticHandler(ctx->llvm, NULL, NULL);
+    LLVMDisposeMemoryBuffer(buffer);
+
+    if (failed)
+        return NULL;
+
+    if (!verify(ctx, module, "read") || !optimize(ctx, module)) {
+        LLVMDisposeModule(module);
+        return NULL;
+    }
+    return module;
+}
+
+/* Lower module to a host object file in memory */
+static bool emit_object(pl0c_context_t* ctx, LLVMModuleRef module, char** object,
+                        size_t* object_size)
+{
+    double start = trace_clock();
+    LLVMTargetMachineRef machine = host_machine(ctx, module);
+    if (!machine)
+        return false;
+
+    char* error_msg = NULL;
+    LLVMMemoryBufferRef buffer = NULL;
+    bool ok = !LLVMTargetMachineEmitToMemoryBuffer(machine, module, LLVMObjectFile,
+                                                   &error_msg, &buffer);
+    LLVMDisposeTargetMachine(machine);
+    end_phase(ctx, "emit", start, &ctx->stats.emit_seconds);
+
+    if (!ok) {
+        report(&ctx->diagnostics, "error: %s", error_msg);
+        LLVMDisposeMessage(error_msg);
+        return false;
+    }
+
+    *object_size = LLVMGetBufferSize(buffer);
+    *object = malloc(*object_size);
+    if (*object) {
+        memcpy(*object, LLVMGetBufferStart(buffer), *object_size);
+    } else {
+        report(&ctx->diagnostics, "error: out of memory");
+        ok = false;
+    }
+    LLVMDisposeMemoryBuffer(buffer);
+    return ok;
+}
+
+bool pl0c_compile_object(pl0c_context_t* ctx, const char* name, const char* text,
+                         size_t len, char** object, size_t* object_size)
+{
+    LLVMModuleRef module = pl0c_compile_module(ctx, name, text, len);
+    if (!module)
+        return false;
+
+    bool ok = emit_object(ctx, module, object, object_size);
+    LLVMDisposeModule(module);
+    return ok;
+}
+
+/* Hash of everything but the unit itself that its object depends on */
+static void unit_base_hash(pl0c_context_t* ctx, const char* name, hasher_t* h)
+{
+    char* triple = LLVMGetDefaultTargetTriple();
+    char* cpu = LLVMGetHostCPUName();
+    char* features = LLVMGetHostCPUFeatures();
+
+    init_hasher(h);
+    hash_string(h, PL0C_VERSION);
+    hash_string(h, LLVM_VERSION_STRING);
+    hash_string(h, triple);
+    hash_string(h, cpu);
+    hash_string(h, features);
+    hash_string(h, name); // recorded as the source file name
+    int flags[] = { ctx->options.opt_level, ctx->options.ssa,
+                    ctx->options.strict_overflow };
+    hash_field(h, flags, sizeof(flags));
+    hash_string(h, ctx->options.passes);
+
+    LLVMDisposeMessage(triple);
+    LLVMDisposeMessage(cpu);
+    LLVMDisposeMessage(features);
+}
+
+bool pl0c_compile_units(pl0c_context_t* ctx, const char* name, const char* text,
+                        size_t len, const pl0c_unit_store_t* store, char** keys,
+                        size_t* unit_count)
+{
+    flat_ast_t ast;
+    symtab_t symtab;
+    call_graph_t calls;
+    if (!front_end(ctx, name, text, len, &ast, &symtab, &calls))
+        return false;
+
+    size_t count = 1 + calls.proc_count;
+    char* unit_keys = malloc(count * (PL0C_UNIT_KEY_LEN + 1));
+    bool ok = unit_keys != NULL;
+    if (ok) {
+        hasher_t base;
+        unit_base_hash(ctx, name, &base);
+        hash_units(&ast, &ctx->names, &calls, &base, unit_keys);
+    } else {
+        report(&ctx->diagnostics, "error: out of memory");
+    }
+
+    /* only units that changed are generated again */
+    for (size_t i = 0; ok && i < count; i++) {
+        const char* key = &unit_keys[i * (PL0C_UNIT_KEY_LEN + 1)];
+        if (store->has(store->user, key))
+            continue;
+
+        size_t unit = i == 0 ? CODEGEN_MAIN : calls.procs[i - 1].node;
+        LLVMModuleRef module = back_end(ctx, name, &ast, &symtab, &calls, unit);
+        char* object = NULL;
+        size_t object_size = 0;
+        ok = module && emit_object(ctx, module, &object, &object_size);
+        if (ok && !store->store(store->user, key, object, object_size)) {
+            report(&ctx->diagnostics, "error: cannot store the object of a unit");
+            ok = false;
+        }
+        free(object);
+        if (module)
+            LLVMDisposeModule(module);
+    }
+
+    free_call_graph(&calls);
+    free_symtab(&symtab);
+    free_flat_ast(&ast);
+
+    if (!ok) {
+        free(unit_keys);
+        return false;
+    }
+    *keys = unit_keys;
+    *unit_count = count;
+    return true;
+}
+
+static bool write_module(pl0c_context_t* ctx, LLVMModuleRef module,
+                         pl0c_emit_t kind, const char* path)
+{
+    char* error_msg = NULL;
+
+    if (kind == PL0C_EMIT_LLVM) {
+        if (LLVMPrintModuleToFile(module, path, &error_msg)) {
+            report(&ctx->diagnostics, "error: %s", error_msg);
+            LLVMDisposeMessage(error_msg);
+            return false;
+        }
+        return true;
+    }
+
+    if (kind == PL0C_EMIT_BITCODE) {
+        if (LLVMWriteBitcodeToFile(module, path)) {
+            report(&ctx->diagnostics, "error: cannot write %s", path);
+            return false;
+        }
+        return true;
+    }
+
+    LLVMTargetMachineRef machine = host_machine(ctx, module);
+    if (!machine)
+        return false;
+
+    LLVMCodeGenFileType type =
+        kind == PL0C_EMIT_ASM ? LLVMAssemblyFile : LLVMObjectFile;
+    bool ok = !LLVMTargetMachineEmitToFile(machine, module, (char*)path, type,
+                                           &error_msg);
+    LLVMDisposeTargetMachine(machine);
+
+    if (!ok) {
+        report(&ctx->diagnostics, "error: %s: %s", path, error_msg);
+        LLVMDisposeMessage(error_msg);
+    }
+    return ok;
+}
+
+bool pl0c_emit_module(pl0c_context_t* ctx, LLVMModuleRef module, pl0c_emit_t kind,
+                      const char* path)
+{
+    double start = trace_clock();
+    bool ok = write_module(ctx, module, kind, path);
+    end_phase(ctx, "emit", start, &ctx->stats.emit_seconds);
+    return ok;
+}
+
+/* Report error if there is one. Returns whether there was. */
+static bool jit_failed(pl0c_context_t* ctx, LLVMErrorRef error)
+{
+    if (!error)
+        return false;
+    char* message = LLVMGetErrorMessage(error);
+    report(&ctx->diagnostics, "error: %s", message);
+    LLVMDisposeErrorMessage(message);
+    return true;
+}
+
+/* Make symbols visible to code in the JIT's main library */
+static bool define_symbols(pl0c_context_t* ctx, LLVMOrcLLJITRef jit,
+                           const pl0c_symbol_t* symbols, size_t symbol_count)
+{
+    if (symbol_count == 0)
+        return true;
+
+    LLVMJITCSymbolMapPair* pairs = malloc(symbol_count * sizeof(*pairs));
+    if (!pairs) {
+        report(&ctx->diagnostics, "error: out of memory");
+        return false;
+    }
+    for (size_t i = 0; i < symbol_count; i++) {
+        pairs[i].Name = LLVMOrcLLJITMangleAndIntern(jit, symbols[i].name);
+        pairs[i].Sym.Address = (LLVMOrcJITTargetAddress)symbols[i].address;
+        pairs[i].Sym.Flags.GenericFlags =
+            LLVMJITSymbolGenericFlagsExported | LLVMJITSymbolGenericFlagsCallable;
+        pairs[i].Sym.Flags.TargetFlags = 0;
+    }
+
+    /* the unit takes over the names, but not the array */
+    LLVMOrcMaterializationUnitRef unit = LLVMOrcAbsoluteSymbols(pairs, symbol_count);
+    free(pairs);
+
+    LLVMOrcJITDylibRef library = LLVMOrcLLJITGetMainJITDylib(jit);
+    LLVMErrorRef error = LLVMOrcJITDylibDefine(library, unit);
+    if (error)
+        LLVMOrcDisposeMaterializationUnit(unit);
+    return !jit_failed(ctx, error);
+}
+
+bool pl0c_run_module(pl0c_context_t* ctx, LLVMModuleRef module,
+                     const pl0c_symbol_t* symbols, size_t symbol_count, int* status)
+{
+    /* a program without a main statement has nothing to run */
+    LLVMValueRef main_function = LLVMGetNamedFunction(module, "main");
+    if (!main_function || LLVMIsDeclaration(main_function)) {
+        report(&ctx->diagnostics, "error: no main statement to run");
+        LLVMDisposeModule(module);
+        return false;
+    }
+
+    /* the JIT generates code the way the backend would for an object file */
+    LLVMTargetMachineRef machine = host_machine(ctx, module);
+    if (!machine) {
+        LLVMDisposeModule(module);
+        return false;
+    }
+
+    LLVMOrcLLJITBuilderRef builder = LLVMOrcCreateLLJITBuilder();
+    LLVMOrcLLJITBuilderSetJITTargetMachineBuilder(
+        builder, LLVMOrcJITTargetMachineBuilderCreateFromTargetMachine(machine));
+
+    LLVMOrcLLJITRef jit;
+    if (jit_failed(ctx, LLVMOrcCreateLLJIT(&jit, builder))) {
+        LLVMDisposeModule(module);
+        return false;
+    }
+
+    /* the backend lowers memory intrinsics, as in the linked runtime, to these */
+    const pl0c_symbol_t builtins[] = {
+        { "memcpy", (void*)memcpy },
+        { "memmove", (void*)memmove },
+        { "memset", (void*)memset },
+    };
+    size_t builtin_count = sizeof(builtins) / sizeof(builtins[0]);
+    bool ok = define_symbols(ctx, jit, builtins, builtin_count) &&
+              define_symbols(ctx, jit, symbols, symbol_count);
+
+    LLVMOrcThreadSafeModuleRef jit_module =
+        LLVMOrcCreateNewThreadSafeModule(module, ctx->jit_context);
+    if (ok) {
+        LLVMErrorRef error = LLVMOrcLLJITAddLLVMIRModule(
+            jit, LLVMOrcLLJITGetMainJITDylib(jit), jit_module);
+        ok = !jit_failed(ctx, error);
+    } else {
+        LLVMOrcDisposeThreadSafeModule(jit_module);
+    }
+
+    LLVMOrcJITTargetAddress address = 0;
+    if (ok)
+        ok = !jit_failed(ctx, LLVMOrcLLJITLookup(jit, &address, "main"));
+
+    /* code is generated on lookup, so a missing symbol fails above */
+    if (ok) {
+        int (*entry)() = (int (*)())address;
+        *status = entry();
+    }
+
+    LLVMOrcDisposeLLJIT(jit);
+    return ok;
+}
+
+size_t pl0c_error_count(const pl0c_context_t* ctx)
+{
+    return ctx->diagnostics.count;
+}
+
+const char* pl0c_error_message(const pl0c_context_t* ctx, size_t i)
+{
+    return i < ctx->diagnostics.count ? ctx->diagnostics.messages[i] : "";
+}
+
+size_t pl0c_remark_count(const pl0c_context_t* ctx)
+{
+    return ctx->remarks.count;
+}
+
+const char* pl0c_remark_message(const pl0c_context_t* ctx, size_t i)
+{
+    return i < ctx->remarks.count ? ctx->remarks.messages[i] : "";
+}
+
+size_t pl0c_event_count(const pl0c_context_t* ctx)
+{
+    return ctx->trace.count;
+}
+
+pl0c_event_t pl0c_event(const pl0c_context_t* ctx, size_t i)
+{
+    pl0c_event_t event = { "", NULL, 0, 0 };
+    if (i < ctx->trace.count) {
+        const trace_event_t* e = &ctx->trace.events[i];
+        event = (pl0c_event_t){ e->name, e->detail, e->start, e->seconds };
+    }
+    return event;
+}
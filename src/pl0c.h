@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef PL0C_H
+#define PL0C_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <llvm-c/Core.h>
+
+#define PL0C_VERSION "0.3.0"
+
+/*
+ * libpl0c compiles PL/0 source held in memory. A context owns every piece of
+ * compiler state, including its own LLVM context, so separate contexts can be
+ * used on different threads at the same time. One context must not be used by
+ * two threads at once.
+ */
+typedef struct pl0c_context pl0c_context_t;
+
+/* Options for the compilations of a context. All zero is -O0. */
+typedef struct {
+    int opt_level;      // 0 to 3, as in -O0 to -O3
+    const char* passes; // pass pipeline run instead of opt_level's, or NULL
+    bool ssa;           // keep procedure locals in SSA values, not stack slots
+    bool whole_program; // only main is used from outside the module
+    bool strict_overflow; // signed overflow is undefined, as in C
+    bool stats; // count IR instructions and record a trace event per phase
+} pl0c_options_t;
+
+/* Output formats of pl0c_emit_module() */
+typedef enum {
+    PL0C_EMIT_LLVM,    // textual IR
+    PL0C_EMIT_BITCODE, // LLVM bitcode
+    PL0C_EMIT_ASM,     // host assembly
+    PL0C_EMIT_OBJECT,  // host object file
+} pl0c_emit_t;
+
+/* A host function or variable that JIT compiled code may refer to by name */
+typedef struct {
+    const char* name;
+    void* address;
+} pl0c_symbol_t;
+
+/*
+ * Measurements of the last compilation. Every phase is timed; a compilation
+ * into units adds up the back end phases of the units it generated.
+ */
+typedef struct {
+    double scan_seconds;
+    double parse_seconds; // including flattening the tree
+    double prune_seconds; // dropping procedures never called
+    double check_seconds;
+    double fold_seconds; // including building the call graph
+    double generate_seconds;
+    double verify_seconds;
+    double optimize_seconds;
+    double emit_seconds;
+    size_t tokens;
+    size_t ast_nodes;
+    size_t symbols;
+    size_t instructions;           // generated, with options.stats
+    size_t optimized_instructions; // left after optimizing, with options.stats
+    size_t procedures_dropped; // never called, so never checked or generated
+} pl0c_stats_t;
+
+/*
+ * A phase of the last compilation, recorded with options.stats: scan, parse,
+ * drop_uncalled, run_semantic_checks, fold_constants, generate_code and a
+ * generate_function in it for each function, verify, optimize and emit
+ */
+typedef struct {
+    const char* name;
+    const char* detail; // the function of generate_function, or NULL
+    double start;       // seconds on the CLOCK_MONOTONIC clock
+    double seconds;
+} pl0c_event_t;
+
+pl0c_context_t* pl0c_create_context();
+
+void pl0c_destroy_context(pl0c_context_t* ctx);
+
+/* options->passes is not copied and must stay valid while ctx uses it */
+void pl0c_set_options(pl0c_context_t* ctx, const pl0c_options_t* options);
+
+const pl0c_stats_t* pl0c_stats(const pl0c_context_t* ctx);
+
+/* The LLVM context that modules compiled by ctx belong to */
+LLVMContextRef pl0c_llvm_context(pl0c_context_t* ctx);
+
+/*
+ * Compile len bytes of source to a verified module named name, optimized as
+ * the context's options say. Returns NULL if the source has errors. The module
+ * belongs to the caller and must be disposed of before ctx is destroyed.
+ */
+LLVMModuleRef pl0c_compile_module(pl0c_context_t* ctx, const char* name,
+                                  const char* text, size_t len);
+
+/*
+ * Read a module from len bytes of LLVM bitcode, as written by
+ * pl0c_emit_module(), and verify and optimize it like a compiled one.
+ */
+LLVMModuleRef pl0c_load_bitcode(pl0c_context_t* ctx, const char* name,
+                                const char* data, size_t len);
+
+/*
+ * Compile to an object file for the host. On success *object holds
+ * *object_size bytes allocated with malloc, to be released with free.
+ */
+bool pl0c_compile_object(pl0c_context_t* ctx, const char* name, const char* text,
+                         size_t len, char** object, size_t* object_size);
+
+/*
+ * Write module to path ("-" for stdout) in the given format. Assembly and
+ * object files are generated in-process for the host, at the code generation
+ * level matching the context's optimization level.
+ */
+bool pl0c_emit_module(pl0c_context_t* ctx, LLVMModuleRef module, pl0c_emit_t kind,
+                      const char* path);
+
+#define PL0C_UNIT_KEY_LEN 32
+
+/*
+ * Where pl0c_compile_units() finds and keeps the object of each unit: has
+ * tells whether the object for key is kept already, store keeps a new one.
+ */
+typedef struct {
+    bool (*has)(void* user, const char* key);
+    bool (*store)(void* user, const char* key, const char* object, size_t size);
+    void* user;
+} pl0c_unit_store_t;
+
+/*
+ * Separate compilation of source into one host object per unit: the globals
+ * with main, and each procedure. A unit is named by a key that hashes all its
+ * object depends on, so only units whose key store doesn't have yet are
+ * generated and handed to it. On success *keys holds *unit_count keys of
+ * PL0C_UNIT_KEY_LEN + 1 bytes each, in one block the caller frees, and the
+ * objects of those keys linked together make the program. Procedures are not
+ * inlined into one another, and -fwhole-program does not apply.
+ */
+bool pl0c_compile_units(pl0c_context_t* ctx, const char* name, const char* text,
+                        size_t len, const pl0c_unit_store_t* store, char** keys,
+                        size_t* unit_count);
+
+/*
+ * JIT compile module for the host and call its main function, which may only
+ * refer to the given symbols, and memcpy, memmove and memset, outside the
+ * module. A module optimized by pl0c carries its own print64 and scan64, which
+ * refer to pl0rt_buffers, pl0rt_flush, pl0rt_start_output and pl0rt_refill of
+ * libpl0rt. Fails if the module has no main function. On success *status holds
+ * what main returned. module is consumed either way.
+ */
+bool pl0c_run_module(pl0c_context_t* ctx, LLVMModuleRef module,
+                     const pl0c_symbol_t* symbols, size_t symbol_count, int* status);
+
+/* Errors reported by the last compilation, in the order they were found */
+size_t pl0c_error_count(const pl0c_context_t* ctx);
+
+const char* pl0c_error_message(const pl0c_context_t* ctx, size_t i);
+
+/* Remarks of the last compilation, such as procedures dropped as uncalled */
+size_t pl0c_remark_count(const pl0c_context_t* ctx);
+
+const char* pl0c_remark_message(const pl0c_context_t* ctx, size_t i);
+
+/* Phases of the last compilation, in the order they ended */
+size_t pl0c_event_count(const pl0c_context_t* ctx);
+
+pl0c_event_t pl0c_event(const pl0c_context_t* ctx, size_t i);
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "source.h"
+
+/* Read everything from fd into a heap buffer, for inputs that can't be mapped */
+static bool read_all(int fd, source_t* source)
+{
+    size_t capacity = 1 << 16;
+    size_t len = 0;
+    char* buf = malloc(capacity);
+    if (!buf)
+        return false;
+
+    for (;;) {
+        if (len == capacity) {
+            capacity *= 2;
+            char* grown = realloc(buf, capacity);
+            if (!grown) {
+                free(buf);
+                return false;
+            }
+            buf = grown;
+        }
+
+        ssize_t n = read(fd, buf + len, capacity - len);
+        if (n == 0)
+            break;
+        if (n < 0) {
+            free(buf);
+            return false;
+        }
+        len += n;
+    }
+
+    source->text = buf;
+    source->len = len;
+    source->mapped = false;
+    return true;
+}
+
+/*
+ * Load the file at path, or stdin when path is "-"
+ */
+bool load_source(const char* path, source_t* source)
+{
+    memset(source, 0, sizeof(*source));
+
+    if (strcmp(path, "-") == 0)
+        return read_all(STDIN_FILENO, source);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    bool loaded = false;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (text != MAP_FAILED) {
+            posix_madvise(text, st.st_size, POSIX_MADV_SEQUENTIAL);
+            source->text = text;
+            source->len = st.st_size;
+            source->mapped = true;
+            loaded = true;
+        }
+    }
+
+    /* pipes, character devices and empty files take the buffered path */
+    if (!loaded)
+        loaded = read_all(fd, source);
+
+    close(fd);
+    return loaded;
+}
+
+void release_source(source_t* source)
+{
+    if (source->mapped)
+        munmap((void*)source->text, source->len);
+    else
+        free((void*)source->text);
+    memset(source, 0, sizeof(*source));
+}
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Contents of a source file held in memory. Regular files are mapped read
+ * only; stdin, pipes and other non-seekable inputs are read into a heap
+ * buffer instead.
+ */
+typedef struct {
+    const char* text;
+    size_t len;
+    bool mapped;
+} source_t;
+
+bool load_source(const char* path, source_t* source);
+
+void release_source(source_t* source);
+
+#endif
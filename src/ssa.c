@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ssa.h"
+
+struct ssa_phi {
+    LLVMValueRef phi;
+    size_t var;
+    bool removed;
+    ssa_phi_t* next;            // in ssa_builder_t.phis
+    ssa_phi_t* next_incomplete; // in ssa_block_t.incomplete
+};
+
+struct ssa_pred {
+    ssa_block_t* block;
+    ssa_pred_t* next;
+};
+
+static void out_of_memory()
+{
+    fprintf(stderr, "error: out of memory\n");
+    exit(EXIT_FAILURE);
+}
+
+static void* ssa_alloc(ssa_builder_t* ssa, size_t size)
+{
+    void* ptr = arena_alloc(&ssa->arena, size);
+    if (!ptr)
+        out_of_memory();
+    return ptr;
+}
+
+void init_ssa(ssa_builder_t* ssa, LLVMContextRef context, LLVMTypeRef type)
+{
+    ssa->phi_builder = LLVMCreateBuilderInContext(context);
+    ssa->type = type;
+    ssa->var_count = 0;
+    ssa->phis = NULL;
+    arena_init(&ssa->arena, 64 * 1024);
+}
+
+void free_ssa(ssa_builder_t* ssa)
+{
+    LLVMDisposeBuilder(ssa->phi_builder);
+    arena_release(&ssa->arena);
+}
+
+void ssa_begin_function(ssa_builder_t* ssa, size_t var_count)
+{
+    arena_release(&ssa->arena);
+    ssa->var_count = var_count;
+    ssa->phis = NULL;
+}
+
+ssa_block_t* ssa_new_block(ssa_builder_t* ssa, LLVMBasicBlockRef block)
+{
+    ssa_block_t* new_block = ssa_alloc(ssa, sizeof(ssa_block_t));
+    new_block->block = block;
+    if (ssa->var_count)
+        new_block->defs = ssa_alloc(ssa, ssa->var_count * sizeof(LLVMValueRef));
+    return new_block;
+}
+
+void ssa_add_pred(ssa_builder_t* ssa, ssa_block_t* block, ssa_block_t* pred)
+{
+    ssa_pred_t* new_pred = ssa_alloc(ssa, sizeof(ssa_pred_t));
+    new_pred->block = pred;
+    new_pred->next = block->preds;
+    block->preds = new_pred;
+}
+
+void ssa_write(ssa_block_t* block, size_t var, LLVMValueRef value)
+{
+    block->defs[var] = value;
+}
+
+/* An empty phi at the start of block */
+static ssa_phi_t* new_phi(ssa_builder_t* ssa, ssa_block_t* block, size_t var)
+{
+    LLVMValueRef first = LLVMGetFirstInstruction(block->block);
+    if (first)
+        LLVMPositionBuilderBefore(ssa->phi_builder, first);
+    else
+        LLVMPositionBuilderAtEnd(ssa->phi_builder, block->block);
+
+    ssa_phi_t* phi = ssa_alloc(ssa, sizeof(ssa_phi_t));
+    phi->phi = LLVMBuildPhi(ssa->phi_builder, ssa->type, "");
+    phi->var = var;
+    phi->next = ssa->phis;
+    ssa->phis = phi;
+    return phi;
+}
+
+static void add_phi_operands(ssa_builder_t* ssa, ssa_block_t* block, ssa_phi_t* phi)
+{
+    for (ssa_pred_t* pred = block->preds; pred; pred = pred->next) {
+        LLVMValueRef value = ssa_read(ssa, pred->block, phi->var);
+        LLVMAddIncoming(phi->phi, &value, &pred->block->block, 1);
+    }
+}
+
+void ssa_seal_block(ssa_builder_t* ssa, ssa_block_t* block)
+{
+    for (ssa_phi_t* phi = block->incomplete; phi; phi = phi->next_incomplete) {
+        add_phi_operands(ssa, block, phi);
+    }
+    block->incomplete = NULL;
+    block->sealed = true;
+}
+
+LLVMValueRef ssa_read(ssa_builder_t* ssa, ssa_block_t* block, size_t var)
+{
+    if (block->defs[var])
+        return block->defs[var];
+
+    LLVMValueRef value;
+    if (!block->sealed) {
+        /* operands are added once all predecessors are known */
+        ssa_phi_t* phi = new_phi(ssa, block, var);
+        phi->next_incomplete = block->incomplete;
+        block->incomplete = phi;
+        value = phi->phi;
+    } else if (!block->preds) {
+        value = LLVMGetUndef(ssa->type); // unreachable block
+    } else if (!block->preds->next) {
+        value = ssa_read(ssa, block->preds->block, var);
+    } else {
+        /* written before reading the operands, to end cycles through loops */
+        ssa_phi_t* phi = new_phi(ssa, block, var);
+        ssa_write(block, var, phi->phi);
+        add_phi_operands(ssa, block, phi);
+        value = phi->phi;
+    }
+
+    ssa_write(block, var, value);
+    return value;
+}
+
+void ssa_end_function(ssa_builder_t* ssa)
+{
+    /*
+     * A phi is trivial when all its operands are one value or the phi itself.
+     * Replacing it can make phis using it trivial, so repeat until nothing
+     * changes.
+     */
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (ssa_phi_t* phi = ssa->phis; phi; phi = phi->next) {
+            if (phi->removed)
+                continue;
+
+            LLVMValueRef same = NULL;
+            bool trivial = true;
+            unsigned count = LLVMCountIncoming(phi->phi);
+            for (unsigned i = 0; i < count && trivial; i++) {
+                LLVMValueRef operand = LLVMGetIncomingValue(phi->phi, i);
+                if (operand == same || operand == phi->phi)
+                    continue;
+                trivial = !same;
+                same = operand;
+            }
+            if (!trivial)
+                continue;
+
+            LLVMReplaceAllUsesWith(phi->phi, same ? same : LLVMGetUndef(ssa->type));
+            LLVMInstructionEraseFromParent(phi->phi);
+            phi->removed = true;
+            changed = true;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef SSA_H
+#define SSA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <llvm-c/Core.h>
+
+#include "arena.h"
+
+/*
+ * On the fly SSA construction after Braun et al., "Simple and Efficient
+ * Construction of Static Single Assignment Form" (CC 2013). Variables are
+ * numbered 0 to var_count - 1 within a function. Each block remembers the
+ * value last written to every variable; reading a variable a block does not
+ * define asks its predecessors, placing a phi where they may disagree. A block
+ * is sealed once all its predecessors are known, and phis that turn out to
+ * merge a single value are removed when the function is finished.
+ */
+
+typedef struct ssa_phi ssa_phi_t;
+typedef struct ssa_pred ssa_pred_t;
+
+typedef struct {
+    LLVMBasicBlockRef block;
+    LLVMValueRef* defs; // current value of each variable, NULL if not known here
+    ssa_pred_t* preds;
+    ssa_phi_t* incomplete; // phis waiting for the block to be sealed
+    bool sealed;
+} ssa_block_t;
+
+typedef struct {
+    LLVMBuilderRef phi_builder;
+    LLVMTypeRef type; // of every variable
+    size_t var_count;
+    ssa_phi_t* phis; // every phi of the function, newest first
+    arena_t arena;   // blocks and phis of the current function
+} ssa_builder_t;
+
+void init_ssa(ssa_builder_t* ssa, LLVMContextRef context, LLVMTypeRef type);
+
+void free_ssa(ssa_builder_t* ssa);
+
+/* Forget the previous function and start one with var_count variables */
+void ssa_begin_function(ssa_builder_t* ssa, size_t var_count);
+
+/* Remove phis that merge a single value. Blocks of the function stay valid. */
+void ssa_end_function(ssa_builder_t* ssa);
+
+ssa_block_t* ssa_new_block(ssa_builder_t* ssa, LLVMBasicBlockRef block);
+
+/* Record that control flows from pred to block */
+void ssa_add_pred(ssa_builder_t* ssa, ssa_block_t* block, ssa_block_t* pred);
+
+/* No predecessors will be added to block any more */
+void ssa_seal_block(ssa_builder_t* ssa, ssa_block_t* block);
+
+void ssa_write(ssa_block_t* block, size_t var, LLVMValueRef value);
+
+LLVMValueRef ssa_read(ssa_builder_t* ssa, ssa_block_t* block, size_t var);
+
+#endif
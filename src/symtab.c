@@ -10,65 +10,153 @@
 
 #include "symtab.h"
 
-#define EQUAL(a, b) (strcmp((a)->name, (b)->name) == 0 && (a)->level == (b)->level)
+static void out_of_memory()
+{
+    fprintf(stderr, "error: out of memory\n");
+    exit(EXIT_FAILURE);
+}
 
-static symbol_t* current_tip = NULL;
-static size_t total_symbol_count = 0;
-static bool error = false;
+void init_symtab(symtab_t* table, const intern_table_t* names,
+                 diag_list_t* diagnostics)
+{
+    memset(table, 0, sizeof(*table));
+    table->names = names;
+    table->diagnostics = diagnostics;
+    arena_init(&table->arena, 16 * 1024);
+}
 
-symbol_t* lookup(char* name)
+void free_symtab(symtab_t* table)
 {
-    symbol_t* tmp = current_tip;
-    while (tmp) {
-        if (strcmp(tmp->name, name) == 0) {
-            return tmp;
-        }
-        tmp = tmp->prev;
+    arena_release(&table->arena);
+    free(table->slots);
+    free(table->symbols);
+    free(table->scopes);
+    memset(table, 0, sizeof(*table));
+}
+
+void push_scope(symtab_t* table)
+{
+    if (table->scope_count == table->scope_capacity) {
+        size_t capacity = table->scope_capacity ? table->scope_capacity * 2 : 8;
+        scope_t* scopes = realloc(table->scopes, capacity * sizeof(scope_t));
+        if (!scopes)
+            out_of_memory();
+        table->scopes = scopes;
+        table->scope_capacity = capacity;
     }
-    return NULL;
+
+    scope_t* scope = &table->scopes[table->scope_count++];
+    scope->first_symbol = table->symbol_count;
+    scope->mark = arena_mark(&table->arena);
 }
 
-symbol_t* new_symbol(char* name, sym_type_t type, LLVMValueRef value, size_t level)
+/* Close the innermost scope and return the number of symbols it held */
+size_t pop_scope(symtab_t* table)
 {
-    symbol_t* new_symbol_obj = calloc(1, sizeof(symbol_t));
-    strcpy(new_symbol_obj->name, name);
-    new_symbol_obj->type = type;
-    new_symbol_obj->value = value;
-    new_symbol_obj->level = level;
-    new_symbol_obj->next = NULL;
-    new_symbol_obj->prev = NULL;
-    return new_symbol_obj;
+    scope_t* scope = &table->scopes[--table->scope_count];
+    size_t count = table->symbol_count - scope->first_symbol;
+
+    size_t mask = table->slot_count - 1;
+    for (size_t i = scope->first_symbol; i < table->symbol_count; i++) {
+        symbol_t* sym = table->symbols[i];
+        size_t slot = interned_hash(table->names, sym->name) & mask;
+        while (table->slots[slot].name != sym->name)
+            slot = (slot + 1) & mask;
+        table->slots[slot].symbol = sym->shadowed;
+    }
+
+    table->symbol_count = scope->first_symbol;
+    arena_rewind(&table->arena, scope->mark);
+    return count;
 }
 
-bool insert_sym(symbol_t** table, symbol_t* new_symbol_obj)
+size_t current_level(const symtab_t* table)
 {
-    symbol_t* current_symbol = *table;
-    if (!current_symbol) {
-        *table = new_symbol_obj;
-        current_tip = new_symbol_obj;
-        total_symbol_count++;
-        return true;
+    return table->scope_count ? table->scope_count - 1 : 0;
+}
+
+/*
+ * Find the slot for name, or the empty slot where it would go. Slots are never
+ * emptied: a name whose symbols have all gone out of scope keeps its slot with
+ * a NULL symbol, so probing needs no tombstones.
+ */
+static sym_slot_t* find_slot(const symtab_t* table, uint32_t name)
+{
+    if (!table->slot_count)
+        return NULL;
+
+    size_t mask = table->slot_count - 1;
+    size_t slot = interned_hash(table->names, name) & mask;
+    while (table->slots[slot].name != NO_IDENT && table->slots[slot].name != name)
+        slot = (slot + 1) & mask;
+    return &table->slots[slot];
+}
+
+static void grow_slots(symtab_t* table)
+{
+    size_t old_count = table->slot_count;
+    sym_slot_t* old_slots = table->slots;
+
+    table->slot_count = old_count ? old_count * 2 : 256;
+    table->slots = calloc(table->slot_count, sizeof(sym_slot_t));
+    if (!table->slots)
+        out_of_memory();
+
+    for (size_t i = 0; i < old_count; i++) {
+        if (old_slots[i].name != NO_IDENT)
+            *find_slot(table, old_slots[i].name) = old_slots[i];
     }
+    free(old_slots);
+}
 
-    while (current_symbol->next) {
-        if (EQUAL(current_symbol, new_symbol_obj)) {
-            free(new_symbol_obj);
-            return false;
-        }
-        current_symbol = current_symbol->next;
+symbol_t* lookup(const symtab_t* table, uint32_t name)
+{
+    sym_slot_t* slot = find_slot(table, name);
+    return slot ? slot->symbol : NULL;
+}
+
+symbol_t* insert_sym(symtab_t* table, uint32_t name, sym_type_t type,
+                     LLVMValueRef value)
+{
+    /* keep the load factor at or below 1/2 */
+    if (2 * (table->slots_used + 1) > table->slot_count)
+        grow_slots(table);
+
+    size_t level = current_level(table);
+    sym_slot_t* slot = find_slot(table, name);
+    if (slot->symbol && slot->symbol->level == level) {
+        return NULL;
     }
 
-    if (EQUAL(current_symbol, new_symbol_obj)) {
-        free(new_symbol_obj);
-        return false;
+    if (table->symbol_count == table->symbol_capacity) {
+        size_t capacity = table->symbol_capacity ? table->symbol_capacity * 2 : 64;
+        symbol_t** symbols = realloc(table->symbols, capacity * sizeof(symbol_t*));
+        if (!symbols)
+            out_of_memory();
+        table->symbols = symbols;
+        table->symbol_capacity = capacity;
     }
 
-    new_symbol_obj->next = NULL;
-    new_symbol_obj->prev = current_symbol;
-    current_symbol->next = new_symbol_obj;
-    current_tip = current_tip->next;
-    total_symbol_count++;
-    return true;
+    symbol_t* new_symbol_obj = arena_alloc(&table->arena, sizeof(symbol_t));
+    if (!new_symbol_obj)
+        out_of_memory();
+    new_symbol_obj->name = name;
+    new_symbol_obj->type = type;
+    new_symbol_obj->value = value;
+    new_symbol_obj->level = level;
+    new_symbol_obj->index = table->symbol_count;
+    if (table->scope_count)
+        new_symbol_obj->index -= table->scopes[level].first_symbol;
+    new_symbol_obj->shadowed = slot->symbol;
+
+    if (slot->name == NO_IDENT) {
+        slot->name = name;
+        table->slots_used++;
+    }
+    slot->symbol = new_symbol_obj;
+    table->symbols[table->symbol_count++] = new_symbol_obj;
+    table->declared_count++;
+    return new_symbol_obj;
 }
 
 static void print_sym_type(sym_type_t type)
@@ -86,206 +174,153 @@ static void print_sym_type(sym_type_t type)
     }
 }
 
-void print_table(symbol_t** table)
+void print_table(const symtab_t* table)
 {
-    symbol_t* current_symbol = *table;
-    if (!current_symbol)
+    if (!table->symbol_count)
         printf("table empty\n");
-    while (current_symbol) {
+    for (size_t i = 0; i < table->symbol_count; i++) {
+        symbol_t* current_symbol = table->symbols[i];
         printf("sym_type: ");
         print_sym_type(current_symbol->type);
         printf("sym_name: %s\nsym_value: %ld\nnesting_level: %zu\n\n",
-               current_symbol->name, (int64_t)(current_symbol->value),
-               current_symbol->level);
-        current_symbol = current_symbol->next;
+               interned_string(table->names, current_symbol->name),
+               (int64_t)(current_symbol->value), current_symbol->level);
     }
 }
 
-size_t free_current_scope(size_t* current_level)
+void run_semantic_checks(const flat_ast_t* ast, size_t node, symtab_t* table)
 {
-    size_t level = *current_level;
-    size_t count = 0;
-    symbol_t* tmp;
-    while (current_tip && current_tip->level == level) {
-        tmp = current_tip;
-        current_tip = current_tip->prev;
-        free(tmp);
-        count++;
-    }
-    total_symbol_count -= count;
-    return count;
-}
+    ast_label_t label = flat_label(ast, node);
 
-void run_semantic_checks(ast_node_t* root, symbol_t** symbol_table,
-                         size_t* current_level)
-{
-    if (root->label == AST_CONST_DECL) {
-        ast_node_t* current = root->first_child;
-        while (current) {
-            symbol_t* new_symtab_entry =
-                new_symbol(current->ident_name, SYM_CONST,
-                           (LLVMValueRef)(current->first_child->num_value),
-                           *current_level);
-            if (insert_sym(symbol_table, new_symtab_entry)) {
-                // fprintf("inserted CONST : %s\n", current->ident_name);
-            }
+    if (label == AST_ROOT) {
+        push_scope(table); // globals
+    }
 
-            else {
-                fprintf(stderr, "redeclaration of identifier %s\n",
-                        current->ident_name);
-                error = true;
+    if (label == AST_CONST_DECL) {
+        FOR_EACH_CHILD(ast, node, current)
+        {
+            LLVMValueRef value =
+                (LLVMValueRef)(flat_num(ast, flat_first_child(current)));
+            if (!insert_sym(table, flat_ident(ast, current), SYM_CONST, value)) {
+                report(table->diagnostics, "redeclaration of identifier %s",
+                       interned_string(table->names, flat_ident(ast, current)));
+                table->error = true;
             }
-            current = current->next_sibling;
         }
     }
 
-    else if (root->label == AST_VAR_DECL) {
-        ast_node_t* current = root->first_child;
-        while (current) {
-            symbol_t* new_symtab_entry =
-                new_symbol(current->ident_name, SYM_VAR, 0, *current_level);
-            if (insert_sym(symbol_table, new_symtab_entry)) {
-                // printf("inserted VAR : %s\n", current->ident_name);
-            }
-
-            else {
-                fprintf(stderr, "redeclaration of identifier %s\n",
-                        current->ident_name);
-                error = true;
+    else if (label == AST_VAR_DECL) {
+        FOR_EACH_CHILD(ast, node, current)
+        {
+            if (!insert_sym(table, flat_ident(ast, current), SYM_VAR, 0)) {
+                report(table->diagnostics, "redeclaration of identifier %s",
+                       interned_string(table->names, flat_ident(ast, current)));
+                table->error = true;
             }
-            current = current->next_sibling;
         }
     }
 
-    else if (root->label == AST_PROC_DECL) {
-        ast_node_t* current = root->first_child;
-        symbol_t* new_symtab_entry =
-            new_symbol(current->ident_name, SYM_PROCEDURE, 0, *current_level);
-        if (insert_sym(symbol_table, new_symtab_entry)) {
-            // printf("inserted PROC : %s\n", current->ident_name);
-        }
-
-        else {
-            fprintf(stderr, "redeclaration of identifier %s\n", current->ident_name);
-            error = true;
+    else if (label == AST_PROC_DECL) {
+        size_t current = flat_first_child(node);
+        if (!insert_sym(table, flat_ident(ast, current), SYM_PROCEDURE, 0)) {
+            report(table->diagnostics, "redeclaration of identifier %s",
+                   interned_string(table->names, flat_ident(ast, current)));
+            table->error = true;
         }
 
         // parse procedure body separately
-        (*current_level)++;
-        if (*current_level >= 2) {
-            fprintf(stderr, "error: nested functions are not supported\n");
-            error = true;
+        push_scope(table);
+        if (current_level(table) >= 2) {
+            report(table->diagnostics, "error: nested functions are not supported");
+            table->error = true;
         }
-        current = current->next_sibling;
-        run_semantic_checks(current, symbol_table, current_level);
-        // printf("freed %zu symbols from global scope\n",
-        // free_current_scope(current_level));
-        free_current_scope(current_level);
-        (*current_level)--;
+        current = flat_next_sibling(ast, current);
+        run_semantic_checks(ast, current, table);
+        pop_scope(table);
     }
 
-    else if (root->label == AST_ASSIGN) {
-        // printf("%s\n", root->first_child->ident_name);
+    else if (label == AST_ASSIGN) {
         // look up left child
-        symbol_t* found = lookup(root->first_child->ident_name);
+        symbol_t* found = lookup(table, flat_ident(ast, flat_first_child(node)));
         if (!found) {
-            fprintf(stderr, "error: use of undefined identifier\n");
-            error = true;
-        } else if (found->type != VAR) {
-            fprintf(stderr,
-                    "error: cannot assign/reassign values to constants or "
-                    "procedures\n");
-            error = true;
+            report(table->diagnostics, "error: use of undefined identifier");
+            table->error = true;
+        } else if (found->type != SYM_VAR) {
+            report(table->diagnostics, "error: cannot assign/reassign values to "
+                                       "constants or procedures");
+            table->error = true;
         }
     }
 
-    else if (root->label == AST_CALL) {
-        symbol_t* found = lookup(root->first_child->ident_name);
+    else if (label == AST_CALL) {
+        symbol_t* found = lookup(table, flat_ident(ast, flat_first_child(node)));
         if (!found) {
-            fprintf(stderr, "error: call to an undefined procedure \n");
-            error = true;
+            report(table->diagnostics, "error: call to an undefined procedure");
+            table->error = true;
         }
 
         else if (found->type != SYM_PROCEDURE) {
-            fprintf(
-                stderr,
-                "error: Found local const/var identifier during function call.\n "
-                "      Change variable or procedure name to fix this\n");
-            error = true;
+            report(table->diagnostics,
+                   "error: Found local const/var identifier during function call.\n"
+                   "       Change variable or procedure name to fix this");
+            table->error = true;
         }
     }
 
-    else if (root->label == AST_PRINT) {
-        if (root->first_child->label == AST_IDENT) {
-            symbol_t* found = lookup(root->first_child->ident_name);
+    else if (label == AST_PRINT) {
+        size_t operand = flat_first_child(node);
+        if (flat_label(ast, operand) == AST_IDENT) {
+            symbol_t* found = lookup(table, flat_ident(ast, operand));
             if (!found) {
-                fprintf(stderr, "error: call to an undefined procedure \n");
-                error = true;
+                report(table->diagnostics, "error: call to an undefined procedure");
+                table->error = true;
             }
 
             else if (found->type == SYM_PROCEDURE) {
-                fprintf(stderr,
-                        "error: Identifier to be printed should be a var/const.\n ");
-                error = true;
+                report(table->diagnostics,
+                       "error: Identifier to be printed should be a var/const.");
+                table->error = true;
             }
         }
     }
 
-    else if (root->label == AST_SCAN) {
-        symbol_t* found = lookup(root->first_child->ident_name);
+    else if (label == AST_SCAN) {
+        symbol_t* found = lookup(table, flat_ident(ast, flat_first_child(node)));
         if (!found) {
-            fprintf(stderr, "error: use of undefined identifier \n");
-            error = true;
+            report(table->diagnostics, "error: use of undefined identifier");
+            table->error = true;
         }
 
         else if (found->type != SYM_VAR) {
-            fprintf(stderr,
-                    "error: can't change value of a constant or procedure\n");
-            error = true;
+            report(table->diagnostics,
+                   "error: can't change value of a constant or procedure");
+            table->error = true;
         }
     }
 
     else {
-        ast_node_t* c_root = root->first_child;
-        while (c_root) {
-            run_semantic_checks(c_root, symbol_table, current_level);
-            c_root = c_root->next_sibling;
+        FOR_EACH_CHILD(ast, node, c_root)
+        {
+            run_semantic_checks(ast, c_root, table);
         }
     }
 
-    if (root->label == AST_ROOT) {
-        // printf("freed %zu symbols from global scope\n",
-        // free_current_scope(current_level));
-        free_current_scope(current_level);
-        current_tip = NULL;
-        *symbol_table = NULL;
+    if (label == AST_ROOT) {
+        pop_scope(table);
     }
 }
 
-size_t symbol_count()
+size_t symbol_count(const symtab_t* table)
 {
-    return total_symbol_count;
+    return table->symbol_count;
 }
 
-bool semantic_error()
+size_t declared_symbols(const symtab_t* table)
 {
-    return error;
+    return table->declared_count;
 }
 
-/* Save details of the scope */
-void save_scope(symbol_t** location, size_t* current_level)
+bool semantic_error(const symtab_t* table)
 {
-    size_t level = *current_level;
-    symbol_t* tmp = NULL;
-    while (current_tip && current_tip->level == level) {
-        tmp = current_tip;
-        current_tip = current_tip->prev;
-    }
-    if (!tmp)
-        return;
-
-    *location = tmp;
-    if (current_tip) {
-        current_tip->next = NULL;
-    }
-}
\ No newline at end of file
+    return table->error;
+}
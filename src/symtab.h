@@ -7,7 +7,10 @@
 #ifndef SYMTAB_H
 #define SYMTAB_H
 
+#include "arena.h"
 #include "ast.h"
+#include "diag.h"
+#include "intern.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -21,31 +24,80 @@ typedef enum {
 } sym_type_t;
 
 typedef struct symbol {
-    char name[32];
+    uint32_t name; // interned
     LLVMValueRef value;
+    int64_t constant; // value of a CONST, once folding has seen its declaration
     size_t level; // nesting level
+    uint32_t index; // position among the symbols of its scope
     sym_type_t type;
-    struct symbol* next;
-    struct symbol* prev;
+    struct symbol* shadowed; // same name in an enclosing scope
 } symbol_t;
 
-void run_semantic_checks(ast_node_t* root, symbol_t** symbol_table,
-                         size_t* current_level);
+/* Slot of the name -> symbol hash table */
+typedef struct {
+    uint32_t name; // NO_IDENT if the slot is empty
+    symbol_t* symbol; // innermost visible symbol, NULL once its scope is popped
+} sym_slot_t;
 
-symbol_t* lookup(char* name);
+/* State saved when a scope is opened, restored when it is closed */
+typedef struct {
+    size_t first_symbol; // index into symtab_t.symbols
+    arena_mark_t mark;
+} scope_t;
 
-symbol_t* new_symbol(char* name, sym_type_t type, LLVMValueRef value, size_t level);
+/*
+ * Scoped symbol table. Names map to their innermost symbol through an open
+ * addressing hash table; each symbol links to the one it shadows. Symbols are
+ * allocated from an arena and listed in declaration order, so closing a scope
+ * unlinks its symbols and releases their memory in one step.
+ */
+typedef struct {
+    const intern_table_t* names;
+    diag_list_t* diagnostics;
+    bool error;
+
+    arena_t arena;
+    sym_slot_t* slots;
+    size_t slot_count;
+    size_t slots_used;
+
+    symbol_t** symbols; // in declaration order, innermost scope last
+    size_t symbol_count;
+    size_t symbol_capacity;
+    size_t declared_count; // symbols ever inserted, including closed scopes
+
+    scope_t* scopes;
+    size_t scope_count;
+    size_t scope_capacity;
+} symtab_t;
+
+void init_symtab(symtab_t* table, const intern_table_t* names,
+                 diag_list_t* diagnostics);
+
+void free_symtab(symtab_t* table);
+
+void push_scope(symtab_t* table);
+
+size_t pop_scope(symtab_t* table);
+
+/* Nesting level of the innermost open scope, 0 for globals */
+size_t current_level(const symtab_t* table);
+
+symbol_t* lookup(const symtab_t* table, uint32_t name);
 
-size_t free_current_scope(size_t* current_level);
+/* Returns NULL if name is already declared in the innermost scope */
+symbol_t* insert_sym(symtab_t* table, uint32_t name, sym_type_t type,
+                     LLVMValueRef value);
 
-bool insert_sym(symbol_t** table, symbol_t* new_symbol_obj);
+void run_semantic_checks(const flat_ast_t* ast, size_t node, symtab_t* table);
 
-void print_table(symbol_t** table);
+void print_table(const symtab_t* table);
 
-bool semantic_error();
+bool semantic_error(const symtab_t* table);
 
-size_t symbol_count();
+size_t symbol_count(const symtab_t* table);
 
-void save_scope(symbol_t** location, size_t* current_level);
+/* Symbols declared since init_symtab(), in scopes open or closed */
+size_t declared_symbols(const symtab_t* table);
 
-#endif
\ No newline at end of file
+#endif
@@ -5,123 +5,174 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "token.h"
 
-void clear_token(token_t* t)
+/* Grow the per-token arrays to hold at least capacity entries */
+static bool reserve_tokens(token_stream_t* stream, size_t capacity)
 {
-    // printf("%d\n", sizeof(t->value));
-    memset(t->value, 0, sizeof(t->value));
-    t->num_value = 0;
-    t->symbol = CONST;
+    uint8_t* symbols = realloc(stream->symbols, capacity * sizeof(uint8_t));
+    if (!symbols)
+        return false;
+    stream->symbols = symbols;
+
+    uint32_t* offsets = realloc(stream->offsets, capacity * sizeof(uint32_t));
+    if (!offsets)
+        return false;
+    stream->offsets = offsets;
+
+    uint32_t* lengths = realloc(stream->lengths, capacity * sizeof(uint32_t));
+    if (!lengths)
+        return false;
+    stream->lengths = lengths;
+
+    stream->capacity = capacity;
+    return true;
 }
 
-void print_symbol(token_symbol_t s)
+bool init_token_stream(token_stream_t* stream, const char* source,
+                       size_t expected_tokens)
+{
+    memset(stream, 0, sizeof(*stream));
+    stream->source = source;
+    return reserve_tokens(stream, expected_tokens ? expected_tokens : 16);
+}
+
+bool push_token(token_stream_t* stream, token_symbol_t symbol, uint32_t offset,
+                uint32_t length)
+{
+    if (stream->count == stream->capacity &&
+        !reserve_tokens(stream, stream->capacity * 2)) {
+        return false;
+    }
+
+    stream->symbols[stream->count] = symbol;
+    stream->offsets[stream->count] = offset;
+    stream->lengths[stream->count] = length;
+    stream->count++;
+    return true;
+}
+
+bool push_num(token_stream_t* stream, int64_t value)
+{
+    if (stream->num_count == stream->num_capacity) {
+        size_t capacity = stream->num_capacity ? stream->num_capacity * 2 : 64;
+        int64_t* nums = realloc(stream->nums, capacity * sizeof(int64_t));
+        if (!nums)
+            return false;
+        stream->nums = nums;
+        stream->num_capacity = capacity;
+    }
+
+    stream->nums[stream->num_count++] = value;
+    return true;
+}
+
+bool push_ident(token_stream_t* stream, uint32_t id)
+{
+    if (stream->ident_count == stream->ident_capacity) {
+        size_t capacity = stream->ident_capacity ? stream->ident_capacity * 2 : 256;
+        uint32_t* idents = realloc(stream->idents, capacity * sizeof(uint32_t));
+        if (!idents)
+            return false;
+        stream->idents = idents;
+        stream->ident_capacity = capacity;
+    }
+
+    stream->idents[stream->ident_count++] = id;
+    return true;
+}
+
+void free_token_stream(token_stream_t* stream)
+{
+    free(stream->symbols);
+    free(stream->offsets);
+    free(stream->lengths);
+    free(stream->nums);
+    free(stream->idents);
+    memset(stream, 0, sizeof(*stream));
+}
+
+const char* symbol_name(token_symbol_t s)
 {
     switch (s) {
         case ASSIGN:
-            printf("ASSIGN");
-            break;
+            return "ASSIGN";
         case CONST:
-            printf("CONST");
-            break;
+            return "CONST";
         case VAR:
-            printf("VAR");
-            break;
+            return "VAR";
         case PROCEDURE:
-            printf("PROCEDURE");
-            break;
+            return "PROCEDURE";
         case CALL:
-            printf("CALL");
-            break;
+            return "CALL";
         case BEGIN:
-            printf("BEGIN");
-            break;
+            return "BEGIN";
         case END:
-            printf("END");
-            break;
+            return "END";
         case IF:
-            printf("IF");
-            break;
+            return "IF";
         case ELSE:
-            printf("ELSE");
-            break;
+            return "ELSE";
         case WHILE:
-            printf("WHILE");
-            break;
+            return "WHILE";
         case ODD:
-            printf("ODD");
-            break;
+            return "ODD";
         case IDENT:
-            printf("IDENT");
-            break;
+            return "IDENT";
         case NUM:
-            printf("NUM");
-            break;
+            return "NUM";
         case PLUS:
-            printf("PLUS");
-            break;
+            return "PLUS";
         case MINUS:
-            printf("MINUS");
-            break;
+            return "MINUS";
         case TIMES:
-            printf("TIMES");
-            break;
+            return "TIMES";
         case SLASH:
-            printf("SLASH");
-            break;
+            return "SLASH";
         case GTE:
-            printf("GTE");
-            break;
+            return "GTE";
         case LTE:
-            printf("LTE");
-            break;
+            return "LTE";
         case GREATER:
-            printf("GREATER");
-            break;
+            return "GREATER";
         case LESSER:
-            printf("LESSER");
-            break;
+            return "LESSER";
         case EQUAL:
-            printf("EQUAL");
-            break;
+            return "EQUAL";
         case NOTEQUAL:
-            printf("NOTEQUAL");
-            break;
+            return "NOTEQUAL";
         case COMMA:
-            printf("COMMA");
-            break;
+            return "COMMA";
         case COLON:
-            printf("COLON");
-            break;
+            return "COLON";
         case SEMICOLON:
-            printf("SEMICOLON");
-            break;
+            return "SEMICOLON";
         case LPAREN:
-            printf("LPAREN");
-            break;
+            return "LPAREN";
         case RPAREN:
-            printf("RPAREN");
-            break;
+            return "RPAREN";
         case PRINT:
-            printf("PRINT");
-            break;
+            return "PRINT";
         case SCAN:
-            printf("SCAN");
-            break;
+            return "SCAN";
         case LIST_END:
-            printf("LIST_END");
-            break;
+            return "LIST_END";
         default:
-            printf("ERROR");
-            break;
+            return "ERROR";
     }
 }
 
+void print_symbol(token_symbol_t s)
+{
+    printf("%s", symbol_name(s));
+}
+
 void print_token(token_t t)
 {
-    printf("%s\n%ld\n", t.value, t.num_value);
+    printf("%.*s\n%ld\n", (int)t.length, t.text, t.num_value);
     print_symbol(t.symbol);
     printf("\n\n");
 }
\ No newline at end of file
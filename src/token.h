@@ -7,6 +7,8 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef enum {
@@ -56,16 +58,57 @@ typedef enum {
 
 } token_symbol_t;
 
+/*
+ * A single decoded token. text points into the source buffer and is not NUL
+ * terminated. ident is the interned ID of an IDENT token, NO_IDENT otherwise.
+ */
 typedef struct {
-    char value[32];
+    const char* text;
+    uint32_t length;
+    uint32_t ident;
     int64_t num_value;
     token_symbol_t symbol;
 } token_t;
 
-void clear_token(token_t* t);
+/*
+ * The lexer's output, stored as parallel arrays: one byte of symbol per token
+ * plus the offset and length of its text in the source, which must outlive the
+ * stream. Values of NUM tokens and interned IDs of IDENT tokens go to side
+ * tables, in the order they appear.
+ */
+typedef struct {
+    const char* source;
+    uint8_t* symbols;
+    uint32_t* offsets;
+    uint32_t* lengths;
+    size_t count;
+    size_t capacity;
+
+    int64_t* nums;
+    size_t num_count;
+    size_t num_capacity;
+
+    uint32_t* idents;
+    size_t ident_count;
+    size_t ident_capacity;
+} token_stream_t;
+
+bool init_token_stream(token_stream_t* stream, const char* source,
+                       size_t expected_tokens);
+
+bool push_token(token_stream_t* stream, token_symbol_t symbol, uint32_t offset,
+                uint32_t length);
+
+bool push_num(token_stream_t* stream, int64_t value);
+
+bool push_ident(token_stream_t* stream, uint32_t id);
+
+void free_token_stream(token_stream_t* stream);
 
 void print_token(token_t t);
 
+const char* symbol_name(token_symbol_t s);
+
 void print_symbol(token_symbol_t s);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+
+void init_trace(trace_t* trace)
+{
+    memset(trace, 0, sizeof(*trace));
+}
+
+double trace_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void trace_event(trace_t* trace, const char* name, const char* detail,
+                 double start, double end)
+{
+    if (!trace->enabled)
+        return;
+
+    if (trace->count == trace->capacity) {
+        size_t capacity = trace->capacity ? trace->capacity * 2 : 64;
+        trace_event_t* events =
+            realloc(trace->events, capacity * sizeof(trace_event_t));
+        if (!events)
+            return;
+        trace->events = events;
+        trace->capacity = capacity;
+    }
+
+    char* copy = NULL;
+    if (detail && !(copy = strdup(detail)))
+        return;
+    trace->events[trace->count++] =
+        (trace_event_t){ name, copy, start, end - start };
+}
+
+void clear_trace(trace_t* trace)
+{
+    for (size_t i = 0; i < trace->count; i++) {
+        free(trace->events[i].detail);
+    }
+    trace->count = 0;
+}
+
+void free_trace(trace_t* trace)
+{
+    clear_trace(trace);
+    free(trace->events);
+    init_trace(trace);
+}
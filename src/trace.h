@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A phase of a compilation, from start for seconds */
+typedef struct {
+    const char* name; // static, such as "optimize"
+    char* detail;     // what the phase worked on, such as a procedure, or NULL
+    double start;     // on the clock of trace_clock()
+    double seconds;
+} trace_event_t;
+
+/*
+ * Phases of one compilation in the order they ended, for --stats and
+ * -ftime-trace. A disabled trace records nothing, so a phase costs only the
+ * clock reads of its caller.
+ */
+typedef struct {
+    trace_event_t* events;
+    size_t count;
+    size_t capacity;
+    bool enabled;
+} trace_t;
+
+void init_trace(trace_t* trace);
+
+/* Seconds on a monotonic clock */
+double trace_clock(void);
+
+/*
+ * Record the phase name on detail, if any, running from start until end.
+ * Events that cannot be stored for lack of memory are dropped.
+ */
+void trace_event(trace_t* trace, const char* name, const char* detail,
+                 double start, double end);
+
+void clear_trace(trace_t* trace);
+
+void free_trace(trace_t* trace);
+
+#endif
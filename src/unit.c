@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#include "unit.h"
+
+static void hash_node(hasher_t* h, const flat_ast_t* ast,
+                      const intern_table_t* names, size_t node)
+{
+    uint8_t label = ast->nodes[node].label;
+    uint32_t size = ast->nodes[node].size;
+    hash_bytes(h, &label, sizeof(label));
+    hash_bytes(h, &size, sizeof(size));
+
+    if (label == AST_IDENT) {
+        uint32_t id = flat_ident(ast, node);
+        hash_field(h, interned_string(names, id), interned_length(names, id));
+    } else if (label == AST_NUM) {
+        int64_t value = flat_num(ast, node);
+        hash_bytes(h, &value, sizeof(value));
+    }
+}
+
+static void hash_subtree(hasher_t* h, const flat_ast_t* ast,
+                         const intern_table_t* names, size_t node)
+{
+    for (size_t i = node; i < flat_end(ast, node); i++) {
+        hash_node(h, ast, names, i);
+    }
+}
+
+/* What a declaration of the procedure tells its callers */
+static void hash_declaration(hasher_t* h, const flat_ast_t* ast,
+                             const intern_table_t* names, const cg_proc_t* proc)
+{
+    hash_node(h, ast, names, flat_first_child(proc->node));
+    hash_bytes(h, &proc->recursive, sizeof(proc->recursive));
+}
+
+void hash_units(const flat_ast_t* ast, const intern_table_t* names,
+                const call_graph_t* graph, const hasher_t* base, char* keys)
+{
+    hasher_t h = *base;
+    hash_string(&h, "main");
+    size_t proc = 0;
+    FOR_EACH_CHILD(ast, 0, current)
+    {
+        if (flat_label(ast, current) == AST_PROC_DECL) {
+            hash_declaration(&h, ast, names, &graph->procs[proc++]);
+        } else {
+            hash_subtree(&h, ast, names, current);
+        }
+    }
+    hash_hex(&h, keys);
+
+    for (size_t i = 0; i < graph->proc_count; i++) {
+        const cg_proc_t* p = &graph->procs[i];
+        h = *base;
+        hash_string(&h, "procedure");
+        hash_subtree(&h, ast, names, p->node);
+        hash_bytes(&h, &p->recursive, sizeof(p->recursive));
+        for (size_t j = 0; j < p->callee_count; j++) {
+            uint32_t callee = graph->callees[p->first_callee + j];
+            hash_declaration(&h, ast, names, &graph->procs[callee]);
+        }
+        hash_hex(&h, &keys[(i + 1) * (HASH_HEX_LEN + 1)]);
+    }
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) Ronak Chauhan
+ * This file is part of pl0c and is licensed under the terms of the MIT License.
+ * See LICENSE for more details.
+ */
+
+#ifndef UNIT_H
+#define UNIT_H
+
+#include "ast.h"
+#include "callgraph.h"
+#include "hash.h"
+#include "intern.h"
+
+/*
+ * Key of each unit of separate compilation, in keys[i * (HASH_HEX_LEN + 1)]:
+ * first main with the globals, then procedure i - 1 of graph. Each key extends
+ * base with what the unit's code depends on: the unit's own subtree, with
+ * names spelled out and procedures reduced to their declarations in main's,
+ * and whether the procedures it calls can recurse. CONSTs are expected to be
+ * folded already, so references to globals are only by name.
+ */
+void hash_units(const flat_ast_t* ast, const intern_table_t* names,
+                const call_graph_t* graph, const hasher_t* base, char* keys);
+
+#endif